@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "ContentionManager.h"
+
+#ifdef USE_GSTATS
+#include <cstring> // gstats.h uses memset without including it
+#include "gstats.h"
+#endif
+
+/**
+ * where a transaction aborted, carried by TxAbortException next to the AbortReason
+ */
+enum class AbortSite : uint8_t {
+    USER,               // thrown by the caller (TX::run counts it)
+    LIST_GET_PRED,      // LinkedList::getPred, the predecessor of the key
+    LIST_GET_NEXT,      // LinkedList::getNext, a node on the way
+    LIST_VALIDATE,      // LinkedList::validateNode, a node whose value or next was read
+    QUEUE_READ_ONLY,    // Queue::isEmpty in a read only transaction
+    QUEUE_LOCK,         // Queue, taking the queue for the transaction
+    QUEUE_VALIDATE,     // Queue, the version of the queue
+    TX_END_LOCK,        // TXend, locking the write set and the queues
+    TX_END_READ_SET,    // TXend, validating the read set
+    TX_END_QUEUES,      // TXend, validating the queues
+    TX_END_NOT_ACTIVE,  // TXend without a running transaction
+};
+
+static constexpr size_t N_ABORT_SITES = 11;
+
+inline const char* abortSiteName(AbortSite site) {
+    switch (site) {
+        case AbortSite::USER: return "user";
+        case AbortSite::LIST_GET_PRED: return "list getPred";
+        case AbortSite::LIST_GET_NEXT: return "list getNext";
+        case AbortSite::LIST_VALIDATE: return "list validateNode";
+        case AbortSite::QUEUE_READ_ONLY: return "queue read only";
+        case AbortSite::QUEUE_LOCK: return "queue lock";
+        case AbortSite::QUEUE_VALIDATE: return "queue validate";
+        case AbortSite::TX_END_LOCK: return "TXend lock";
+        case AbortSite::TX_END_READ_SET: return "TXend read set";
+        case AbortSite::TX_END_QUEUES: return "TXend queues";
+        case AbortSite::TX_END_NOT_ACTIVE: return "TXend not active";
+    }
+    return "unknown";
+}
+
+// abort counts by site and reason
+struct AbortBreakdown {
+    uint64_t counts[N_ABORT_SITES][N_ABORT_REASONS] = {};
+
+    uint64_t get(AbortSite site, AbortReason reason) const {
+        return counts[static_cast<size_t>(site)][static_cast<size_t>(reason)];
+    }
+
+    uint64_t bySite(AbortSite site) const {
+        uint64_t sum = 0;
+        for (size_t r = 0; r < N_ABORT_REASONS; r++) {
+            sum += counts[static_cast<size_t>(site)][r];
+        }
+        return sum;
+    }
+
+    uint64_t byReason(AbortReason reason) const {
+        uint64_t sum = 0;
+        for (size_t s = 0; s < N_ABORT_SITES; s++) {
+            sum += counts[s][static_cast<size_t>(reason)];
+        }
+        return sum;
+    }
+
+    uint64_t total() const {
+        uint64_t sum = 0;
+        for (size_t s = 0; s < N_ABORT_SITES; s++) {
+            sum += bySite(static_cast<AbortSite>(s));
+        }
+        return sum;
+    }
+
+    AbortBreakdown operator-(const AbortBreakdown& other) const {
+        AbortBreakdown diff;
+        for (size_t s = 0; s < N_ABORT_SITES; s++) {
+            for (size_t r = 0; r < N_ABORT_REASONS; r++) {
+                diff.counts[s][r] = counts[s][r] - other.counts[s][r];
+            }
+        }
+        return diff;
+    }
+
+    // one line per site that aborted, with its reasons
+    void print(std::ostream& out) const {
+        out << "aborts: " << total() << std::endl;
+        for (size_t s = 0; s < N_ABORT_SITES; s++) {
+            auto site = static_cast<AbortSite>(s);
+            if (bySite(site) == 0) {
+                continue;
+            }
+            out << "  " << abortSiteName(site) << ":";
+            for (size_t r = 0; r < N_ABORT_REASONS; r++) {
+                if (counts[s][r] != 0) {
+                    out << " " << abortReasonName(static_cast<AbortReason>(r)) << ": " << counts[s][r];
+                }
+            }
+            out << std::endl;
+        }
+    }
+};
+
+/**
+ * per thread abort counters. a thread only bumps its own counters (no shared cache lines on the abort path),
+ * snapshot() sums up the running threads and the ones that exited.
+ * a TX only records if its policy counts aborts (TxPolicy.h), ENABLED is the default of the build:
+ * with NO_ABORT_STATS DefaultTxPolicy compiles the counting out and the snapshots stay all zeros.
+ */
+class AbortStats {
+public:
+#ifdef NO_ABORT_STATS
+    static constexpr bool ENABLED = false;
+#else
+    static constexpr bool ENABLED = true;
+#endif
+
+    static void record(AbortSite site, AbortReason reason) {
+        auto& c = local().counts[static_cast<size_t>(site)][static_cast<size_t>(reason)];
+        // only this thread writes it
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // the aborts of all threads so far
+    static AbortBreakdown snapshot() {
+        AbortBreakdown b;
+        auto& r = registry();
+        std::lock_guard<std::mutex> l(r.lock);
+        b = r.exited;
+        for (auto t : r.threads) {
+            t->addTo(b);
+        }
+        return b;
+    }
+
+    // the aborts of the calling thread so far
+    static AbortBreakdown localSnapshot() {
+        AbortBreakdown b;
+        local().addTo(b);
+        return b;
+    }
+
+#ifdef USE_GSTATS
+    // a stat with one index per site and reason (site * N_ABORT_REASONS + reason), see addToGstats
+    static gstats_stat_id createGstat(gstats_t& stats) {
+        return stats.create_stat(LONG_LONG, "tx_aborts", N_ABORT_SITES * N_ABORT_REASONS,
+                                 {gstats_output_item(PRINT_RAW, SUM, BY_INDEX)});
+    }
+
+    // adds the aborts of the calling thread (since it started) as thread tid, call once at the end of a thread
+    static void addToGstats(gstats_t& stats, gstats_stat_id id, int tid) {
+        auto b = localSnapshot();
+        for (size_t s = 0; s < N_ABORT_SITES; s++) {
+            for (size_t r = 0; r < N_ABORT_REASONS; r++) {
+                if (b.counts[s][r] != 0) {
+                    stats.add_stat<long long>(tid, id, b.counts[s][r], s * N_ABORT_REASONS + r);
+                }
+            }
+        }
+    }
+#endif
+
+private:
+    struct ThreadCounters;
+
+    struct Registry {
+        std::mutex lock;
+        std::vector<ThreadCounters*> threads;
+        AbortBreakdown exited;
+    };
+
+    struct ThreadCounters {
+        std::atomic<uint64_t> counts[N_ABORT_SITES][N_ABORT_REASONS];
+
+        ThreadCounters() {
+            for (auto& site : counts) {
+                for (auto& c : site) {
+                    c.store(0, std::memory_order_relaxed);
+                }
+            }
+            auto& r = registry();
+            std::lock_guard<std::mutex> l(r.lock);
+            r.threads.push_back(this);
+        }
+
+        ~ThreadCounters() {
+            auto& r = registry();
+            std::lock_guard<std::mutex> l(r.lock);
+            addTo(r.exited);
+            r.threads.erase(std::find(r.threads.begin(), r.threads.end(), this));
+        }
+
+        ThreadCounters(const ThreadCounters&) = delete;
+
+        void addTo(AbortBreakdown& b) const {
+            for (size_t s = 0; s < N_ABORT_SITES; s++) {
+                for (size_t r = 0; r < N_ABORT_REASONS; r++) {
+                    b.counts[s][r] += counts[s][r].load(std::memory_order_relaxed);
+                }
+            }
+        }
+    };
+
+    static Registry& registry() {
+        static Registry r;
+        return r;
+    }
+
+    static ThreadCounters& local() {
+        static thread_local ThreadCounters counters;
+        return counters;
+    }
+};
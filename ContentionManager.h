@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "nodes/utils.h"
+
+/**
+ * why a transaction aborted, carried by TxAbortException
+ */
+enum class AbortReason : uint8_t {
+    EXPLICIT,           // thrown by the caller
+    LOCKED,             // read a node (or a queue) locked by another transaction or singleton
+    NEWER_VERSION,      // read a node (or a queue) written after the read version
+    SINGLETON_CONFLICT, // read a singleton write of the read version
+    COMMIT_LOCK,        // TXend couldn't lock its write set (or a queue)
+    NOT_ACTIVE,         // TXend without a running transaction (an operation aborted it already)
+};
+
+static constexpr size_t N_ABORT_REASONS = 6;
+
+inline const char* abortReasonName(AbortReason reason) {
+    switch (reason) {
+        case AbortReason::EXPLICIT: return "explicit";
+        case AbortReason::LOCKED: return "locked";
+        case AbortReason::NEWER_VERSION: return "newer version";
+        case AbortReason::SINGLETON_CONFLICT: return "singleton conflict";
+        case AbortReason::COMMIT_LOCK: return "commit lock";
+        case AbortReason::NOT_ACTIVE: return "not active";
+    }
+    return "unknown";
+}
+
+/**
+ * how TX::run retries an aborted transaction
+ * EXPONENTIAL - waits min_spins * 2^retries (up to max_spins) before the next attempt
+ * RANDOMIZED  - a random wait up to the exponential one, so the aborted transactions spread out
+ * KARMA       - the transactions that retried the most go first: a transaction waits longer
+ *               the fewer retries it has compared to the most retried running transaction
+ * IMMEDIATE   - retries right away
+ * after irrevocable_after attempts (0 - never) the transaction runs irrevocably: it waits until
+ * no other TX::run transaction is running and keeps the others out until it commits.
+ * only TX::run takes part: transactions begun by hand (TXbegin / TXend) and singleton operations don't wait
+ * for the token, so they can still commit writes that abort the irrevocable attempt, which is then retried
+ * (still irrevocably, without backoff)
+ */
+struct RetryPolicy {
+    enum class Backoff { IMMEDIATE, EXPONENTIAL, RANDOMIZED, KARMA };
+
+    Backoff backoff = Backoff::EXPONENTIAL;
+    uint32_t min_spins = 16;
+    uint32_t max_spins = 16384;
+    uint32_t irrevocable_after = 64;
+
+    RetryPolicy() = default;
+
+    explicit RetryPolicy(Backoff backoff, uint32_t irrevocable_after = 64) :
+        backoff(backoff),
+        irrevocable_after(irrevocable_after)
+    {}
+};
+
+// what happened to the last TX::run of a thread
+struct RunStats {
+    uint32_t attempts = 0;
+    uint32_t aborts[N_ABORT_REASONS] = {};
+    bool irrevocable = false;
+};
+
+/**
+ * the state TX::run shares between threads: the irrevocable token, the number of running attempts and
+ * the karma (retries) of the most retried transaction. the token only excludes the attempts of TX::run
+ * (see RetryPolicy), the commits outside of it never look at it
+ */
+class ContentionManager {
+public:
+    ContentionManager() : m_irrevocable(false), m_active(0), m_max_karma(0) {}
+
+    // spins (pause) n times, and gives up the CPU after a long wait
+    static void spin(uint32_t n) {
+        for (uint32_t i = 0; i < n; i++) {
+            __asm__ __volatile__("pause;");
+        }
+        if (n >= YIELD_SPINS) {
+            std::this_thread::yield();
+        }
+    }
+
+    // the wait before attempt number attempts (the first retry is attempt 1)
+    uint32_t backoffSpins(const RetryPolicy& policy, uint32_t attempts) const {
+        uint32_t shift = std::min<uint32_t>(attempts - 1, 31);
+        uint64_t exp = std::min<uint64_t>(static_cast<uint64_t>(policy.min_spins) << shift, policy.max_spins);
+        switch (policy.backoff) {
+            case RetryPolicy::Backoff::IMMEDIATE:
+                return 0;
+            case RetryPolicy::Backoff::EXPONENTIAL:
+                return static_cast<uint32_t>(exp);
+            case RetryPolicy::Backoff::RANDOMIZED:
+                return static_cast<uint32_t>(get_random_in_range(0, exp + 1));
+            case RetryPolicy::Backoff::KARMA: {
+                uint32_t max_karma = m_max_karma;
+                uint32_t behind = std::min<uint32_t>(max_karma > attempts ? max_karma - attempts : 0, 31);
+                return static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(policy.min_spins) << behind,
+                                                                policy.max_spins));
+            }
+        }
+        return 0;
+    }
+
+    void onAbort(uint32_t attempts) {
+        uint32_t karma = m_max_karma;
+        while (karma < attempts && !m_max_karma.compare_exchange_weak(karma, attempts));
+    }
+
+    // the most retried transaction committed, the others start over from 0
+    void onCommit(uint32_t attempts) {
+        uint32_t karma = attempts;
+        if (attempts > 0) {
+            m_max_karma.compare_exchange_strong(karma, 0);
+        }
+    }
+
+    // a revocable attempt, waits while a transaction runs irrevocably
+    void enter() {
+        while (true) {
+            while (m_irrevocable) {
+                spin(YIELD_SPINS);
+            }
+            m_active++;
+            if (!m_irrevocable) {
+                return;
+            }
+            m_active--;
+        }
+    }
+
+    void exit() {
+        m_active--;
+    }
+
+    // takes the irrevocable token and waits for the running attempts to end
+    void enterIrrevocable() {
+        bool expected = false;
+        while (!m_irrevocable.compare_exchange_weak(expected, true)) {
+            expected = false;
+            spin(YIELD_SPINS);
+        }
+        while (m_active != 0) {
+            spin(YIELD_SPINS);
+        }
+    }
+
+    void exitIrrevocable() {
+        m_irrevocable = false;
+    }
+
+private:
+    static constexpr uint32_t YIELD_SPINS = 1024;
+
+    std::atomic<bool> m_irrevocable;
+    std::atomic<uint32_t> m_active;
+    std::atomic<uint32_t> m_max_karma;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <type_traits>
+
+/**
+ * an append only log with small-buffer inline storage.
+ * the first INLINE_N entries live inside the log itself, the rest spill into a vector
+ * whose capacity is kept across clear(), so a thread local log stops allocating once it is warm.
+ */
+template <typename T, size_t INLINE_N = 16>
+class FlatLog {
+public:
+    class iterator {
+    public:
+        iterator(FlatLog* log, size_t i) : m_log(log), m_i(i) {}
+        T& operator*() const { return (*m_log)[m_i]; }
+        T* operator->() const { return &(*m_log)[m_i]; }
+        iterator& operator++() { ++m_i; return *this; }
+        bool operator==(const iterator& other) const { return m_i == other.m_i; }
+        bool operator!=(const iterator& other) const { return m_i != other.m_i; }
+    private:
+        FlatLog* m_log;
+        size_t m_i;
+    };
+
+    FlatLog() : m_size(0) {}
+
+    void push_back(T val) {
+        if (m_size < INLINE_N) {
+            m_inline[m_size] = std::move(val);
+        } else {
+            m_overflow.push_back(std::move(val));
+        }
+        m_size++;
+    }
+
+    T& operator[](size_t i) {
+        return i < INLINE_N ? m_inline[i] : m_overflow[i - INLINE_N];
+    }
+
+    const T& operator[](size_t i) const {
+        return i < INLINE_N ? m_inline[i] : m_overflow[i - INLINE_N];
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    // drops the entries but keeps the memory for the next transaction
+    void clear() {
+        if (!std::is_trivially_destructible<T>::value) {
+            // release whatever the inline entries hold (e.g. node references)
+            for (size_t i = 0; i < m_size && i < INLINE_N; i++) {
+                m_inline[i] = T{};
+            }
+        }
+        m_overflow.clear();
+        m_size = 0;
+    }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, m_size); }
+
+private:
+    std::array<T, INLINE_N> m_inline;
+    std::vector<T> m_overflow;
+    size_t m_size;
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <urcu/tsc.h>
+
+/**
+ * global version clock strategies for TX, selected at compile time (GVC_GV4, GVC_GV5, GVC_GV6, GVC_TSC).
+ * every clock provides:
+ *  read()          - the read version of a starting transaction / version of a singleton write
+ *  commit()        - the write version of a committing transaction, called with its locks held,
+ *                    always greater than the read version of any transaction that started before
+ *  bump()          - advance the clock after a singleton conflict, returns the new version
+ *  observe(v)      - a transaction aborted because it saw version v newer than its read version
+ */
+
+// GV1: a plain shared counter, every commit and every singleton conflict increments it
+class GV1Clock {
+public:
+    GV1Clock() : m_clock(0) {}
+
+    uint64_t read() const { return m_clock; }
+    uint64_t commit() { return ++m_clock; }
+    uint64_t bump() { return ++m_clock; }
+    void observe(uint64_t) {}
+
+private:
+    std::atomic<uint64_t> m_clock;
+};
+
+namespace clock_ops {
+    // TL2 GV4 increment: a committer that loses the CAS uses the winner's version instead of retrying
+    inline uint64_t incrementPassOnFailure(std::atomic<uint64_t>& clock) {
+        uint64_t g = clock;
+        if (clock.compare_exchange_strong(g, g + 1)) {
+            return g + 1;
+        }
+        // g now holds the value someone else installed after we took our locks
+        return g;
+    }
+
+    inline void advanceTo(std::atomic<uint64_t>& clock, uint64_t version) {
+        uint64_t g = clock;
+        while (g < version && !clock.compare_exchange_weak(g, version));
+    }
+}
+
+// GV4: GV1 with "pass on failure" increments
+class GV4Clock {
+public:
+    GV4Clock() : m_clock(0) {}
+
+    uint64_t read() const { return m_clock; }
+    uint64_t commit() { return clock_ops::incrementPassOnFailure(m_clock); }
+    uint64_t bump() { return clock_ops::incrementPassOnFailure(m_clock); }
+    void observe(uint64_t) {}
+
+private:
+    std::atomic<uint64_t> m_clock;
+};
+
+// GV5: commits don't write the clock at all (wv = clock + 1), readers that trip over a newer version advance it
+class GV5Clock {
+public:
+    GV5Clock() : m_clock(0) {}
+
+    uint64_t read() const { return m_clock; }
+    uint64_t commit() { return m_clock + 1; }
+    uint64_t bump() { return ++m_clock; }
+    void observe(uint64_t version) { clock_ops::advanceTo(m_clock, version); }
+
+private:
+    std::atomic<uint64_t> m_clock;
+};
+
+// GV6: GV5, but every INCREMENT_PERIOD-th commit of a thread increments the clock like GV4,
+// so readers don't always have to abort to move it forward
+class GV6Clock {
+public:
+    static constexpr uint32_t INCREMENT_PERIOD = 32;
+
+    GV6Clock() : m_clock(0) {}
+
+    uint64_t read() const { return m_clock; }
+
+    uint64_t commit() {
+        static thread_local uint32_t commits = 0;
+        if (++commits % INCREMENT_PERIOD == 0) {
+            return clock_ops::incrementPassOnFailure(m_clock);
+        }
+        return m_clock + 1;
+    }
+
+    uint64_t bump() { return ++m_clock; }
+    void observe(uint64_t version) { clock_ops::advanceTo(m_clock, version); }
+
+private:
+    std::atomic<uint64_t> m_clock;
+};
+
+/**
+ * a clock with no shared cache line at all: the (invariant, cross core synchronized) time stamp counter.
+ * versions are (tsc - tsc when the clock was created) >> TICK_SHIFT, so they fit the 48 version bits of a node for ~270 days at 3GHz.
+ * a commit takes now + 1 and waits for the clock to reach it, so anyone starting after the commit reads a version >= wv.
+ * only correct on machines with an invariant TSC that is synchronized across cores/sockets.
+ */
+class TscClock {
+public:
+    static constexpr uint64_t TICK_SHIFT = 8;
+
+    TscClock() : m_base(read_tsc()) {}
+
+    uint64_t read() const {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return (read_tsc() - m_base) >> TICK_SHIFT;
+    }
+
+    uint64_t commit() {
+        uint64_t wv = read() + 1;
+        while (read() < wv) {
+            __asm__ __volatile__("pause;");
+        }
+        return wv;
+    }
+
+    uint64_t bump() { return commit(); }
+    void observe(uint64_t) {}
+
+private:
+    const uint64_t m_base;
+};
+
+#if defined(GVC_GV4)
+using GlobalClock = GV4Clock;
+#elif defined(GVC_GV5)
+using GlobalClock = GV5Clock;
+#elif defined(GVC_GV6)
+using GlobalClock = GV6Clock;
+#elif defined(GVC_TSC)
+using GlobalClock = TscClock;
+#else
+using GlobalClock = GV1Clock;
+#endif
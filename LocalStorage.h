@@ -1,70 +1,269 @@
 #pragma once
 
-#include <unordered_map>
-#include <unordered_set>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
 #include <vector>
 #include <ostream>
 
 #include "nodes/LNode.h"
+#include "nodes/VNode.h"
+#include "nodes/record_mgr.h"
+#include "ContentionManager.h"
 #include "WriteElement.h"
-#include "datatypes/LocalQueue.h"
+#include "WriteSet.h"
+#include "FlatLog.h"
 
-template <typename key_t, typename val_t>
-class LinkedList;
+template <typename key_t, typename val_t, typename record_mgr_t>
+class Index;
 
-template <typename val_t>
-class Queue;
+/**
+ * the type erased side of the LocalStorage of one key and value type, so TXend commits every structure
+ * the transaction touched (of any key and value type) together, with one increment of the clock.
+ * a storage adds itself to the storages of its thread (of its BasicTX policy, see BasicTX::threadStorages)
+ * when it's created.
+ * the phases run in this order: lockWriteSet, validateReadSet, commit (after the clock increment),
+ * unlockWriteSet, updateIndex, clear
+ */
+class LocalStorageBase {
+public:
+    // storages is created before the storage, so it outlives it
+    explicit LocalStorageBase(std::vector<LocalStorageBase*>& storages) : m_storages(storages) {
+        m_storages.push_back(this);
+    }
 
-namespace std {
-    template <typename val_t>
-    struct hash<Queue<val_t>>
-    {
-        std::size_t operator()(const Queue<val_t>& q) const
-        {
-            return q.hash();
-        }
-    };
-}
+    virtual ~LocalStorageBase() {
+        m_storages.erase(std::find(m_storages.begin(), m_storages.end(), this));
+    }
+
+    LocalStorageBase(const LocalStorageBase&) = delete;
+
+    // nothing read or written (and no guard held) since the last clear
+    virtual bool isEmpty() const = 0;
+
+    // the guard of the record manager the storage's structures use, held for the whole commit
+    // (unless a TxContext holds it already)
+    virtual void startOp() = 0;
+    virtual void endOp() = 0;
 
-template <typename key_t, typename val_t>
-class LocalStorage {
+    /**
+     * false (with nothing left locked by the next unlockWriteSet) if a node couldn't be locked.
+     * sorted - in node address order, spinning up to maxSpins on a taken lock (CommitLockMode::SORTED_SPIN)
+     */
+    virtual bool lockWriteSet(bool sorted, uint32_t maxSpins, uint64_t owner, bool& waited) = 0;
+    // false with the reason, and the version of the node for NEWER_VERSION
+    virtual bool validateReadSet(uint64_t owner, uint64_t readVersion, AbortReason& reason,
+                                 uint64_t& seenVersion) = 0;
+    // oldestSnapshot - the oldest read version a snapshot may still read at (BasicTX::oldestSnapshot),
+    //                  the older versions it needs are kept by multi version storages
+    virtual void commit(uint64_t writeVersion, uint64_t oldestSnapshot) = 0;
+    virtual void unlockWriteSet() = 0;
+    virtual void updateIndex(uint64_t writeVersion, uint64_t oldestSnapshot) = 0;
+    // after an abort, the nodes that were never linked go back to the record manager
+    virtual void recycle() = 0;
+    // also ends the guard of a TxContext
+    virtual void clear() = 0;
+
+private:
+    std::vector<LocalStorageBase*>& m_storages;
+};
+
+template <typename key_t, typename val_t, typename record_mgr_t = RecordMgr<key_t, val_t>>
+class LocalStorage : public LocalStorageBase {
 public:
     using node_t = LNodeWrapper<key_t,val_t>;
+    using index_t = Index<key_t, val_t, record_mgr_t>;
 
-    //TODO add when queue is implmented
-    std::unordered_map<Queue<val_t>*, LocalQueue<val_t>> queueMap;
-    std::unordered_map<node_t, WriteElement<key_t, val_t>> writeSet;
-    std::unordered_set<node_t> readSet;
-    std::unordered_map<LinkedList<key_t, val_t>*, std::vector<node_t>> indexAdd;
-    std::unordered_map<LinkedList<key_t, val_t>*, std::vector<node_t>> indexRemove;
+    // all the logs below are thread local and reused, clear() keeps their memory
+    WriteSet<key_t, val_t> writeSet;
+    FlatLog<node_t> readSet; // append only, a node may appear more than once
+    FlatLog<std::pair<index_t*, node_t>> indexAdd;
+    FlatLog<std::pair<index_t*, node_t>> indexRemove;
+    std::vector<size_t> lockOrder; // commit time scratch, write set indices in lock acquisition order
+    size_t lockedCount = 0; // the prefix of lockOrder that is locked
+    // the record manager of the running transaction, set by the operations (and the typed TXend)
+    const record_mgr_t* recordMgr = nullptr;
+    bool guardHeld = false; // a TxContext holds the guard of recordMgr until the transaction ends, see BasicTX::context
+
+    // multiVersion - commits keep the older versions of the nodes for the snapshots (TxPolicy::MULTI_VERSION)
+    LocalStorage(std::vector<LocalStorageBase*>& storages, bool multiVersion) :
+        LocalStorageBase(storages),
+        m_multiVersion(multiVersion)
+    {}
 
     void putIntoWriteSet(node_t node, node_t next, Optional<val_t> val, bool deleted) {
         WriteElement<key_t, val_t> we;
         we.next = next;
         we.deleted = deleted;
         we.val = val;
-        writeSet[node] = we;
+        writeSet.put(node, we);
+    }
+
+    void addToIndexAdd(index_t* index, node_t node) {
+        indexAdd.push_back(std::make_pair(index, std::move(node)));
     }
 
-    void addToIndexAdd(LinkedList<key_t, val_t>* list, node_t node) {
-        auto nodes_it = indexAdd.find(list);
-        if(indexAdd.count(list) == 0) {
-            indexAdd[list] = std::vector<node_t>();
+    void addToIndexRemove(index_t* index, node_t node) {
+        indexRemove.push_back(std::make_pair(index, std::move(node)));
+    }
+
+    bool isEmpty() const override {
+        return writeSet.empty() && readSet.empty() && indexAdd.empty() && !guardHeld;
+    }
+
+    void startOp() override {
+        if (!guardHeld) {
+            recordMgr->startOp();
         }
-        auto& nodes = indexAdd[list];
-        nodes.push_back(std::move(node));
-        //indexAdd.put(list, nodes);
     }
 
-    void addToIndexRemove(LinkedList<key_t, val_t>* list, node_t node) {
-        auto nodes_it = indexRemove.find(list);
-        if(indexRemove.count(list) == 0) {
-            indexRemove[list] = std::vector<node_t>();
+    void endOp() override {
+        if (!guardHeld) {
+            recordMgr->endOp();
         }
-        auto& nodes = indexRemove[list];
-        nodes.push_back(std::move(node));
-        //indexRemove.put(list, nodes);
     }
 
-};
+    // lockOrder holds write set indices in acquisition order, the locked nodes are a prefix of it
+    bool lockWriteSet(bool sorted, uint32_t maxSpins, uint64_t owner, bool& waited) override {
+        lockOrder.clear();
+        lockedCount = 0;
+        for (size_t i = 0; i < writeSet.size(); i++) {
+            lockOrder.push_back(i);
+        }
+        if (sorted) {
+            auto& ws = writeSet;
+            std::sort(lockOrder.begin(), lockOrder.end(), [&ws](size_t a, size_t b) {
+                return ws[a].node < ws[b].node;
+            });
+        }
+        for (auto i : lockOrder) {
+            if (!lockForCommit(writeSet[i].node, owner, sorted ? maxSpins : 0, waited)) {
+                return false;
+            }
+            lockedCount++;
+        }
+        return true;
+    }
+
+    bool validateReadSet(uint64_t owner, uint64_t readVersion, AbortReason& reason,
+                         uint64_t& seenVersion) override {
+        using lnode_t = LNode<key_t, val_t>;
+        for (auto& node : readSet) {
+            // a single load of the node word, our own locks are told apart by the owner bits
+            uint64_t version_mask = node->getVersionMask();
+            uint64_t version = lnode_t::versionOf(version_mask);
+            if (lnode_t::isLockedByOther(version_mask, owner)) {
+                // someone else holds the lock
+                reason = AbortReason::LOCKED;
+                return false;
+            } else if (version > readVersion) {
+                seenVersion = version;
+                reason = AbortReason::NEWER_VERSION;
+                return false;
+            } else if (version == readVersion && lnode_t::isSingletonMask(version_mask)) {
+                // the node isn't ours to write (it may not even be locked), the caller bumps the clock instead
+                reason = AbortReason::SINGLETON_CONFLICT;
+                return false;
+            }
+        }
+        return true;
+    }
 
+    void commit(uint64_t writeVersion, uint64_t oldestSnapshot) override {
+        if (m_multiVersion) {
+            // the inserted nodes didn't exist before writeVersion, the snapshots before it skip them
+            for (auto& index_and_node : indexAdd) {
+                index_and_node.second->setVersionAndSingletonNoLockAssert(writeVersion, false);
+            }
+        }
+        for (auto& entry : writeSet) {
+            node_t& node = entry.node;
+            const auto& we = entry.we;
+            if (m_multiVersion) {
+                pushVersion(node, writeVersion, oldestSnapshot, *recordMgr);
+            }
+            node->m_next = we.next;
+            node->m_val = we.val; // when node val changed because of put
+            if (we.deleted) {
+                node->setDeleted(true);
+                node->m_val = NULLOPT; // for index
+            }
+            node->setVersion(writeVersion);
+            node->setSingleton(false);
+        }
+    }
+
+    void unlockWriteSet() override {
+        for (size_t i = 0; i < lockedCount; i++) {
+            writeSet[lockOrder[i]].node->unlock();
+        }
+        lockedCount = 0;
+    }
+
+    void updateIndex(uint64_t writeVersion, uint64_t oldestSnapshot) override {
+        // adding to index
+        for (auto& index_and_node : indexAdd) {
+            index_and_node.first->add(index_and_node.second, *recordMgr);
+        }
+        // removing from index
+        for (auto& index_and_node : indexRemove) {
+            index_and_node.first->remove(index_and_node.second, *recordMgr);
+            retireUnlinked(index_and_node.first, index_and_node.second, writeVersion, oldestSnapshot, *recordMgr);
+        }
+    }
+
+    /**
+     * a node that was unlinked from the list of index at version. a snapshot before version may still reach it
+     * through the older versions of its predecessor, so a multi version storage leaves it to the index
+     * until oldestSnapshot passes version (Index::retireUnlinked)
+     */
+    void retireUnlinked(index_t* index, node_t node, uint64_t version, uint64_t oldestSnapshot,
+                        const record_mgr_t& recordMgr) {
+        if (!m_multiVersion) {
+            recordMgr.retire_node(std::move(node));
+            return;
+        }
+        index->retireUnlinked(std::move(node), version, oldestSnapshot, recordMgr);
+    }
+
+    // the nodes we wanted to add were never linked, the next inserts of this thread reuse them
+    void recycle() override {
+        for (auto& index_and_node : indexAdd) {
+            recordMgr->recycle_node(index_and_node.second);
+        }
+    }
+
+    void clear() override {
+        writeSet.clear();
+        readSet.clear();
+        indexAdd.clear();
+        indexRemove.clear();
+        lockedCount = 0;
+        if (guardHeld) {
+            guardHeld = false;
+            recordMgr->endOp();
+        }
+    }
+
+private:
+    bool m_multiVersion;
+
+    // spins with exponential backoff up to maxSpins (0 - tries once) on a taken lock
+    static bool lockForCommit(node_t& node, uint64_t owner, uint32_t maxSpins, bool& waited) {
+        if (node->tryLock(owner)) {
+            return true;
+        }
+        uint32_t backoff = 1;
+        for (uint32_t spins = 0; spins < maxSpins; spins += backoff) {
+            for (uint32_t i = 0; i < backoff; i++) {
+                __asm__ __volatile__("pause;");
+            }
+            if (!node->isLocked() && node->tryLock(owner)) {
+                waited = true;
+                return true;
+            }
+            backoff = std::min<uint32_t>(backoff * 2, 64);
+        }
+        return false;
+    }
+};
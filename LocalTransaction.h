@@ -1,9 +1,131 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <stdexcept>
+
+#include "ContentionManager.h"
+
+/**
+ * hands out the small per thread ids that committing transactions keep in the lock bits of a node
+ * (see LNode::tryLock). 0 is never handed out, it is the owner of singleton locks.
+ * ids of threads that exited are reused.
+ */
+class OwnerIds {
+public:
+    static constexpr uint64_t MAX_ID = 0xFFF; // LNode::MAX_OWNER
+
+    static uint64_t acquire() {
+        std::lock_guard<std::mutex> l(state().lock);
+        auto& s = state();
+        if (!s.free_ids.empty()) {
+            auto id = s.free_ids.back();
+            s.free_ids.pop_back();
+            return id;
+        }
+        if (s.next_id > MAX_ID) {
+            throw std::runtime_error("too many threads running transactions at once");
+        }
+        return s.next_id++;
+    }
+
+    static void release(uint64_t id) {
+        std::lock_guard<std::mutex> l(state().lock);
+        state().free_ids.push_back(id);
+    }
+
+private:
+    struct State {
+        std::mutex lock;
+        std::vector<uint64_t> free_ids;
+        uint64_t next_id = 1;
+    };
+
+    static State& state() {
+        static State s;
+        return s;
+    }
+};
+
+/**
+ * the read versions of the running snapshots (read only transactions of a multi version policy), one slot per
+ * owner id, so a commit knows which older versions of its nodes a snapshot may still read (see pushVersion)
+ */
+class SnapshotRegistry {
+public:
+    // the slot of an owner without a running snapshot
+    static constexpr uint64_t IDLE = UINT64_MAX;
+
+    // no slots unless enabled, a TX of a single version policy never has snapshots
+    explicit SnapshotRegistry(bool enabled) : m_slots(enabled ? OwnerIds::MAX_ID + 1 : 0), m_used(0), m_running(0) {
+        for (auto& slot : m_slots) {
+            slot.store(IDLE, std::memory_order_relaxed);
+        }
+    }
+
+    SnapshotRegistry(const SnapshotRegistry&) = delete;
+
+    // announces that owner reads at version or after, before it settles on its read version
+    void enter(uint64_t owner, uint64_t version) {
+        uint64_t used = m_used;
+        while (used <= owner && !m_used.compare_exchange_weak(used, owner + 1)) {}
+        if (m_slots[owner] == IDLE) {
+            m_running++; // before the slot, a running() that missed it was before the announcement
+        }
+        m_slots[owner] = version;
+    }
+
+    void exit(uint64_t owner) {
+        if (m_slots[owner] != IDLE) {
+            m_slots[owner] = IDLE;
+            m_running--;
+        }
+    }
+
+    // some snapshot is announced, without scanning the slots (singleton writes ask on every write)
+    bool running() const {
+        return m_running != 0;
+    }
+
+    // clock is read before the slots, a snapshot that isn't announced yet reads at clock or after
+    uint64_t oldest(uint64_t clock) const {
+        uint64_t res = clock;
+        if (!running()) {
+            return res;
+        }
+        uint64_t used = m_used;
+        for (uint64_t i = 0; i < used; i++) {
+            res = std::min<uint64_t>(res, m_slots[i]);
+        }
+        return res;
+    }
+
+private:
+    std::vector<std::atomic<uint64_t>> m_slots;
+    std::atomic<uint64_t> m_used; // the slots after it were never used
+    std::atomic<uint64_t> m_running; // the slots that aren't IDLE
+};
+
+class QueueBase;
+class LocalStorageBase;
+
 struct LocalTransaction {
+    LocalTransaction() : ownerId(OwnerIds::acquire()) {}
+    ~LocalTransaction() { OwnerIds::release(ownerId); }
+    LocalTransaction(const LocalTransaction&) = delete;
+
     uint64_t readVersion = 0L;
     uint64_t writeVersion = 0L; // for debug
     bool TX = false;
     bool readOnly = true;
+    bool readOnlyMode = false; // started with TXbeginReadOnly, reads are not logged
+    bool snapshot = false; // readOnlyMode of a multi version policy, reads go back to the versions of readVersion
+    uint32_t extensions = 0; // snapshot extensions of the running transaction, see TX::extend
+    const uint64_t ownerId; // this thread's id in the lock bits of the nodes it locks
+    std::vector<QueueBase*> queues; // the queues the running transaction touched, see Queue::getLocalQueue
+    std::vector<LocalStorageBase*> storages; // commit time scratch, the storages (key and value types) it touched
+    RunStats lastRun; // see TX::run
 };
-
@@ -1,42 +1,273 @@
 #pragma once
 
 #include <atomic>
+#include <algorithm>
+#include <type_traits>
 #include "LocalTransaction.h"
+#include "LocalStorage.h"
+#include "TxContext.h"
+#include "TxPolicy.h"
+#include "GlobalClock.h"
+#include "ContentionManager.h"
+#include "AbortStats.h"
+#include "datatypes/QueueBase.h"
 #include "nodes/record_mgr.h"
 
+/**
+ * the outcome of a try operation (LinkedList::tryGet, ...) or of TX::tryCommit, the exception free
+ * counterpart of TxAbortException. an aborted status ends the transaction like a throw does: the caller
+ * calls handle_abort (and retries) before running anything else on this thread.
+ */
+class TxStatus {
+public:
+    static TxStatus ok() {
+        return TxStatus(false, AbortReason::EXPLICIT, AbortSite::USER);
+    }
+
+    static TxStatus aborted(AbortReason reason, AbortSite site) {
+        return TxStatus(true, reason, site);
+    }
+
+    // true if the operation (or the commit) went through
+    explicit operator bool() const {
+        return !m_aborted;
+    }
+
+    AbortReason reason() const {
+        return m_reason;
+    }
+
+    AbortSite site() const {
+        return m_site;
+    }
+
+private:
+    TxStatus(bool aborted, AbortReason reason, AbortSite site) :
+        m_aborted(aborted), m_reason(reason), m_site(site) {}
+
+    bool m_aborted;
+    AbortReason m_reason;
+    AbortSite m_site;
+};
+
 class TxAbortException : public std::exception
 {
+public:
+    explicit TxAbortException(AbortReason reason = AbortReason::EXPLICIT, AbortSite site = AbortSite::USER) :
+        m_reason(reason), m_site(site) {}
+
     const char * what () const throw ()
     {
         return "TX abort";
     }
+
+    AbortReason reason() const {
+        return m_reason;
+    }
+
+    AbortSite site() const {
+        return m_site;
+    }
+
+private:
+    AbortReason m_reason;
+    AbortSite m_site;
 };
 
-class TX {
+/**
+ * the transactions of one configuration (see TxPolicy.h), TX is the one of the build flags.
+ * the thread local state (the running transaction and its logs) is per policy, so the structures of a
+ * transaction all have to be on transactions of the same policy
+ */
+template <typename Policy = DefaultTxPolicy>
+class BasicTX {
 public:
-    std::atomic<uint64_t> gvc;
+    using policy_t = Policy;
+    using CommitLockMode = ::CommitLockMode;
+
+    // the record manager of the policy, with the versioned list nodes if it is multi version (VNode.h)
+    template <typename key_t, typename val_t>
+    using record_mgr_t = typename std::conditional<Policy::MULTI_VERSION,
+            typename Policy::template record_mgr<key_t, val_t>::versioned_t,
+            typename Policy::template record_mgr<key_t, val_t>>::type;
+    template <typename key_t, typename val_t>
+    using storage_t = LocalStorage<key_t, val_t, record_mgr_t<key_t, val_t>>;
+    template <typename key_t, typename val_t>
+    using context_t = TxContext<key_t, val_t, record_mgr_t<key_t, val_t>>;
+
+    typename Policy::Clock gvc;
+
+    static constexpr bool DEBUG_MODE_LL = Policy::DEBUG_LL;
+    static constexpr bool DEBUG_MODE_QUEUE = Policy::DEBUG_QUEUE;
+    static constexpr bool DEBUG_MODE_TX = Policy::DEBUG_TX;
+    static constexpr bool DEBUG_MODE_VERSION = Policy::DEBUG_VERSION;
+
+    explicit BasicTX(CommitLockMode lock_mode = Policy::LOCK_MODE, uint32_t max_lock_spins = 1024) :
+        m_lock_mode(lock_mode),
+        m_max_lock_spins(max_lock_spins),
+        m_aborts_avoided(0),
+        m_extensions(0),
+        m_failed_extensions(0),
+        m_extended_commits(0),
+        m_snapshots(Policy::MULTI_VERSION),
+        m_run_aborts(),
+        m_irrevocable_runs(0)
+    {}
+
+    CommitLockMode getCommitLockMode() const {
+        return m_lock_mode;
+    }
+
+    // number of commits that only succeeded because a taken lock was waited for
+    uint64_t getAbortsAvoided() const {
+        return m_aborts_avoided;
+    }
+
+    // snapshot extensions that moved a read version forward (see extend)
+    uint64_t getExtensions() const {
+        return m_extensions;
+    }
+
+    // snapshot extensions that found the read set changed, their transactions aborted
+    uint64_t getFailedExtensions() const {
+        return m_failed_extensions;
+    }
+
+    // the aborts snapshot extension avoided: commits of transactions that extended their snapshot
+    uint64_t getExtendedCommits() const {
+        return m_extended_commits;
+    }
+
+    // aborts of TX::run transactions for reason, of all threads
+    uint64_t getRunAborts(AbortReason reason) const {
+        return m_run_aborts[static_cast<size_t>(reason)];
+    }
+
+    // TX::run transactions that had to run irrevocably
+    uint64_t getIrrevocableRuns() const {
+        return m_irrevocable_runs;
+    }
+
+    // the attempts and abort reasons of the last TX::run of this thread
+    const RunStats& lastRunStats() const {
+        return get_local_transaction().lastRun;
+    }
+
+    /**
+     * runs op in a transaction until it commits and returns what op returned.
+     * an aborted attempt is cleaned up (handle_abort), counted by its reason and retried after the backoff
+     * of policy. any other exception of op aborts the transaction and is passed on.
+     * op may run several times, so it should only change the data structures (and its own locals).
+     * op may use structures of any key and value types, they commit together
+     */
+    template <typename op_t>
+    auto run(op_t op, const RetryPolicy& policy) -> decltype(op()) {
+        using ret_t = decltype(op());
+        RunScope scope(*this);
+        while (true) {
+            scope.enterAttempt(policy);
+            try {
+                TXbegin();
+                return attempt<ret_t>(op, scope);
+            } catch (TxAbortException& e) {
+                handle_abort();
+                if (e.site() == AbortSite::USER) {
+                    recordAbort(e.site(), e.reason());
+                }
+                scope.onAbort(e.reason());
+            } catch (...) {
+                handle_abort();
+                throw;
+            }
+        }
+    }
+
+    template <typename op_t, typename key_t, typename val_t, typename... rm_params>
+    auto run(op_t op, const RetryPolicy& policy, const RecordMgr<key_t, val_t, rm_params...>& recordMgr)
+            -> decltype(op()) {
+        setRecordMgr(recordMgr);
+        return run(op, policy);
+    }
+
+    // aborts the running transaction from inside an operation, counted in AbortStats (if the policy counts)
+    [[noreturn]] void abort(AbortSite site, AbortReason reason) {
+        abortStatus(site, reason);
+        throw TxAbortException(reason, site);
+    }
 
-    static constexpr bool DEBUG_MODE_LL = false;
-    static constexpr bool DEBUG_MODE_QUEUE = false;
-    static constexpr bool DEBUG_MODE_TX = false;
-    static constexpr bool DEBUG_MODE_VERSION = false;
+    // aborts the running transaction from inside a try operation, counted in AbortStats (if the policy counts)
+    TxStatus abortStatus(AbortSite site, AbortReason reason) {
+        get_local_transaction().TX = false;
+        recordAbort(site, reason);
+        return TxStatus::aborted(reason, site);
+    }
 
-    TX() : gvc(0) {}
+    // the exception API on top of the try API
+    static void throwIfAborted(const TxStatus& status) {
+        if (!status) {
+            throw TxAbortException(status.reason(), status.site());
+        }
+    }
 
     uint64_t getVersion() const {
-        return gvc;
+        return gvc.read();
     }
 
+    // advances the clock after a conflict with a singleton operation
     uint64_t incrementAndGetVersion() {
-        return ++gvc;
+        return gvc.bump();
+    }
+
+    // a transaction is aborting because it saw a node with the newer version
+    void onNewerVersion(uint64_t version) {
+        gvc.observe(version);
+    }
+
+    /**
+     * snapshot extension (as in LSA and TinySTM): the running transaction read a node with version newer than
+     * its read version. if nothing it read so far changed, its read version moves to the clock (>= version)
+     * and it goes on instead of aborting, the caller reads the node again.
+     * false if the read set or a queue changed (the caller aborts), or in a read only transaction (its reads
+     * are not logged, so they can't be validated again). an operation holds the guard of its own record
+     * manager only, the nodes of the other key and value types are revalidated like between two operations
+     */
+    bool extend(uint64_t version) {
+        auto& local_transaction = get_local_transaction();
+        if (!Policy::EXTEND_SNAPSHOT || !local_transaction.TX || local_transaction.readOnlyMode) {
+            return false;
+        }
+        onNewerVersion(version); // GV5 and GV6 move the clock up to version
+        // the clock is read before the validation: a commit that could still get a version up to it
+        // holds its locks already, so the validation sees them
+        uint64_t readVersion = getVersion();
+        AbortReason reason;
+        if (readVersion < version ||
+            !validateReadSets(threadStorages(), local_transaction.ownerId, local_transaction.readVersion, reason) ||
+            !validateQueues(local_transaction, reason)) {
+            m_failed_extensions++;
+            return false;
+        }
+        if (DEBUG_MODE_VERSION) {
+            std::cout << "extend: read version " << local_transaction.readVersion << " -> " << readVersion << std::endl;
+        }
+        local_transaction.readVersion = readVersion;
+        local_transaction.extensions++;
+        m_extensions++;
+        return true;
     }
 
     template <typename key_t, typename val_t>
-    LocalStorage<key_t, val_t>& get_local_storge() const {
-        static thread_local  LocalStorage<key_t, val_t> lStorage;
+    storage_t<key_t, val_t>& get_local_storge() const {
+        static thread_local  storage_t<key_t, val_t> lStorage(threadStorages(), Policy::MULTI_VERSION);
         return lStorage;
     }
 
+    // the storages of the calling thread (of this policy), created before the first storage so it outlives all of them
+    static std::vector<LocalStorageBase*>& threadStorages() {
+        static thread_local std::vector<LocalStorageBase*> storages;
+        return storages;
+    }
+
     LocalTransaction& get_local_transaction() const {
         static thread_local  LocalTransaction transaction;
         return transaction;
@@ -48,201 +279,257 @@ public:
         }
 
         auto& local_transaction = get_local_transaction();
+        releaseQueues(local_transaction); // left over if the last transaction aborted without handle_abort
+        endSnapshot(local_transaction);
+        for (auto storage : threadStorages()) {
+            if (!storage->isEmpty()) {
+                storage->clear();
+            }
+        }
         local_transaction.TX = true;
+        local_transaction.readOnlyMode = false;
+        local_transaction.extensions = 0;
         local_transaction.readVersion = getVersion();
     }
 
-    template <typename key_t, typename val_t>
-    bool TXend(const RecordMgr<key_t, val_t>& recordMgr) {
-        auto guard = recordMgr.getGuard();
-        using node_t = LNodeWrapper<key_t,val_t>;
+    /**
+     * begins a transaction that promises not to write (writes throw std::logic_error).
+     * its reads are validated against the read version as they happen and are not logged,
+     * so TXend doesn't need to validate anything.
+     * with a multi version policy it reads the snapshot of its read version instead: the list nodes written
+     * later are read from their older versions (see VNode.h), so it never aborts on them. the snapshot only
+     * reads the clock, the singleton writes that see it running take a newer version (singletonVersion)
+     */
+    void TXbeginReadOnly() {
+        TXbegin();
+        auto& local_transaction = get_local_transaction();
+        local_transaction.readOnlyMode = true;
+        if (Policy::MULTI_VERSION) {
+            // announced before the read version is taken, so a commit keeps what the snapshot will read
+            m_snapshots.enter(local_transaction.ownerId, local_transaction.readVersion);
+            local_transaction.readVersion = getVersion();
+            m_snapshots.enter(local_transaction.ownerId, local_transaction.readVersion);
+            local_transaction.snapshot = true;
+        }
+    }
 
+    /**
+     * the version of a singleton write, taken with the locks of the nodes it writes held.
+     * with a multi version policy, while a snapshot runs the clock is bumped so the write is newer than it,
+     * a snapshot announced later reads the nodes after the locks are released
+     * @param oldestSnapshot    set to oldestSnapshot() for the versions the write saves (pushVersion)
+     */
+    uint64_t singletonVersion(uint64_t& oldestSnapshot) {
+        if (!Policy::MULTI_VERSION) {
+            oldestSnapshot = 0;
+            return getVersion();
+        }
+        uint64_t version = m_snapshots.running() ? gvc.bump() : getVersion();
+        oldestSnapshot = this->oldestSnapshot();
+        return version;
+    }
+
+    // the oldest read version of a running snapshot (or of one that starts later), see pushVersion
+    uint64_t oldestSnapshot() const {
+        return m_snapshots.oldest(getVersion());
+    }
+
+    /**
+     * TXbegin that hands out the context of the key and value types of recordMgr, for the operations
+     * that take one (LinkedList::get(ctx, key), ...). the context is thread local, valid until the
+     * transaction commits or aborts, and holds the guard of recordMgr until then
+     */
+    template <typename key_t, typename val_t, typename... rm_params>
+    context_t<key_t, val_t>& TXbegin(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        TXbegin();
+        return context(recordMgr);
+    }
+
+    template <typename key_t, typename val_t, typename... rm_params>
+    context_t<key_t, val_t>& TXbeginReadOnly(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        TXbeginReadOnly();
+        return context(recordMgr);
+    }
+
+    // the context of more key and value types for the running transaction
+    template <typename key_t, typename val_t, typename... rm_params>
+    context_t<key_t, val_t>& context(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        static thread_local context_t<key_t, val_t> ctx;
+        auto& storage = get_local_storge<key_t, val_t>();
+        assert(!storage.guardHeld || storage.recordMgr == &recordMgr); // one record manager per type and thread
+        ctx = context_t<key_t, val_t>(get_local_transaction(), storage, recordMgr);
+        if (!storage.guardHeld) {
+            recordMgr.startOp();
+            storage.guardHeld = true;
+        }
+        return ctx;
+    }
+
+    /**
+     * commits the running transaction, with every structure it touched (of any key and value type)
+     * locked, validated and written in one pass under one clock increment.
+     * throws TxAbortException if it aborted, call handle_abort then
+     */
+    bool TXend() {
+        throwIfAborted(tryCommit());
+        return true;
+    }
+
+    // TXend() that also hands recordMgr to the commit of its key and value types (the operations hand it over already)
+    template <typename key_t, typename val_t, typename... rm_params>
+    bool TXend(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        setRecordMgr(recordMgr);
+        return TXend();
+    }
+
+    template <typename key_t, typename val_t, typename... rm_params>
+    TxStatus tryCommit(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        setRecordMgr(recordMgr);
+        return tryCommit();
+    }
+
+    /**
+     * commits the running transaction, or aborts it and returns why (TXend without the throw).
+     * after an aborted status call handle_abort, like after a TxAbortException
+     */
+    TxStatus tryCommit() {
         if (DEBUG_MODE_TX) {
             std::cout << "TXend" << std::endl;
         }
 
         bool abort = false;
+        AbortReason reason = AbortReason::NOT_ACTIVE;
+        AbortSite site = AbortSite::TX_END_NOT_ACTIVE;
 
-        auto& localStorage = get_local_storge<key_t, val_t>();
         auto& local_transaction = get_local_transaction();
 
+        if (local_transaction.TX && local_transaction.readOnlyMode) {
+            local_transaction.TX = false;
+            local_transaction.readOnlyMode = false;
+            endSnapshot(local_transaction);
+            // nothing was logged, only the guard of a context is left
+            for (auto storage : threadStorages()) {
+                if (!storage->isEmpty()) {
+                    storage->clear();
+                }
+            }
+            return TxStatus::ok();
+        }
+
         if (!local_transaction.TX) {
             abort = true;
         }
 
-        // locking write set
-        auto& writeSet = localStorage.writeSet;
-        std::unordered_set<node_t> lockedLNodes;
+        // the storages the transaction touched, each one holds the guard of its record manager until the end
+        auto& storages = local_transaction.storages;
+        storages.clear();
+        for (auto storage : threadStorages()) {
+            if (!storage->isEmpty()) {
+                storage->startOp();
+                storages.push_back(storage);
+            }
+        }
+
+        // locking write sets
+        bool waitedForLock = false;
         if (!abort) {
-            for (auto node_and_we : writeSet) {
-                node_t node = node_and_we.first;
-                if (!node->tryLock()) {
+            for (auto storage : storages) {
+                if (!storage->lockWriteSet(m_lock_mode == CommitLockMode::SORTED_SPIN, m_max_lock_spins,
+                                           local_transaction.ownerId, waitedForLock)) {
                     abort = true;
+                    reason = AbortReason::COMMIT_LOCK;
+                    site = AbortSite::TX_END_LOCK;
                     break;
                 }
-                lockedLNodes.emplace(std::move(node));
             }
         }
 
-        // locking queues TODO implment
-//        HashMap<Queue, LocalQueue> qMap = localStorage.queueMap;
-//
-//        if (!abort) {
-//
-//            for (Entry<Queue, LocalQueue> entry : qMap.entrySet()) {
-//
-//                Queue queue = entry.getKey();
-//
-//                if (!queue.tryLock()) { // if queue is locked by another thread
-//                    abort = true;
-//                    break;
-//
-//                }
-//
-//                LocalQueue lQueue = entry.getValue();
-//                lQueue.isLockedByMe = true;
-//
-//            }
-//        }
-
-        // validate read set
-
-        auto& readSet = localStorage.readSet;
-
+        // locking queues, the ones we dequeued from are locked already
+        auto& queues = local_transaction.queues;
         if (!abort) {
-
-            for (auto node : readSet) {
-                if (lockedLNodes.count(node) == 0 && node->isLocked()) {
-                    // someone else holds the lock
-                    abort = true;
-                    break;
-                } else if (node->getVersion() > local_transaction.readVersion) {
-                    abort = true;
-                    break;
-                } else if (node->getVersion() == local_transaction.readVersion && node->isSingleton()) {
-                    incrementAndGetVersion(); // increment GVC
-                    node->setSingleton(false);
+            for (auto queue : queues) {
+                if (!queue->lockForCommit(local_transaction.ownerId)) {
                     abort = true;
+                    reason = AbortReason::COMMIT_LOCK;
+                    site = AbortSite::TX_END_LOCK;
                     break;
                 }
             }
         }
 
-        // validate queue TODO implment
-
-//        if (!abort) {
-//            for (Entry<Queue, LocalQueue> entry : qMap.entrySet()) {
-//
-//                Queue queue = entry.getKey();
-//                if (queue.getVersion() > localStorage.readVersion) {
-//                    abort = true;
-//                    break;
-//                } else if (queue.getVersion() == localStorage.readVersion && queue.isSingleton()) {
-//                    incrementAndGetVersion(); // increment GVC
-//                    abort = true;
-//                    break;
-//                }
-//
-//            }
-//
-//        }
+        // validate read sets
+
+        if (!abort && !validateReadSets(storages, local_transaction.ownerId, local_transaction.readVersion, reason)) {
+            abort = true;
+            site = AbortSite::TX_END_READ_SET;
+        }
+
+        // validate queues
+
+        if (!abort && !validateQueues(local_transaction, reason)) {
+            abort = true;
+            site = AbortSite::TX_END_QUEUES;
+        }
 
-        // increment GVC
+        // increment GVC, once for all the structures
 
         uint64_t writeVersion = 0;
+        uint64_t oldestSnapshot = 0;
 
         if (!abort && !local_transaction.readOnly) {
-            writeVersion = incrementAndGetVersion();
+            writeVersion = gvc.commit();
             assert (writeVersion > local_transaction.readVersion);
             local_transaction.writeVersion = writeVersion;
+            if (Policy::MULTI_VERSION) {
+                oldestSnapshot = this->oldestSnapshot();
+            }
         }
 
         // commit
         if (!abort && !local_transaction.readOnly) {
-            // LinkedList
-            for (auto node_and_we : writeSet) {
-                node_t node = node_and_we.first;
-                auto we =  node_and_we.second;
-                node->m_next = we.next;
-                node->m_val = we.val; // when node val changed because of put
-                if (we.deleted) {
-                    node->setDeleted(true);
-                    node->m_val = NULLOPT; // for index
-                }
-                node->setVersion(writeVersion);
-                node->setSingleton(false);
+            // LinkedLists
+            for (auto storage : storages) {
+                storage->commit(writeVersion, oldestSnapshot);
+            }
+            // Queues
+            for (auto queue : queues) {
+                queue->commitLocal(writeVersion);
             }
         }
 
-        //TODO implment
-//        if (!abort) {
-//            // Queue
-//
-//            for (Entry<Queue, LocalQueue> entry : qMap.entrySet()) {
-//
-//                Queue queue = entry.getKey();
-//                LocalQueue lQueue = entry.getValue();
-//
-//                queue.dequeueNodes(lQueue.nodeToDeq);
-//                queue.enqueueNodes(lQueue);
-//                if (TX.DEBUG_MODE_QUEUE) {
-//                    System.out.println("commit queue before set version");
-//                }
-//                queue.setVersion(writeVersion);
-//                queue.setSingleton(false);
-//
-//            }
-//
-//        }
-
         // release locks, even if abort
-        for (auto node : lockedLNodes) {
-            node->unlock();
+        for (auto storage : storages) {
+            storage->unlockWriteSet();
+        }
+        if (!abort && waitedForLock) {
+            m_aborts_avoided++;
+        }
+        if (!abort && local_transaction.extensions != 0) {
+            m_extended_commits++;
         }
 
-        //TODO implment
-
-//        for (Entry<Queue, LocalQueue> entry : qMap.entrySet()) {
-//
-//            Queue queue = entry.getKey();
-//            LocalQueue lQueue = entry.getValue();
-//            if (lQueue.isLockedByMe) {
-//                queue.unlock();
-//                lQueue.isLockedByMe = false;
-//            }
-//        }
+        releaseQueues(local_transaction);
 
         // update index
         if (!abort && !local_transaction.readOnly) {
-            // adding to index
-            auto& indexMap = localStorage.indexAdd;
-            for (auto& list_and_node : indexMap) {
-                auto& list = list_and_node.first;
-                auto& nodes = list_and_node.second;
-                for (auto &node : nodes) {
-                    list->index.add(node);
-                }
-            }
-            // removing from index
-            for (auto& list_and_node : localStorage.indexRemove) {
-                auto& list = list_and_node.first;
-                auto& nodes = list_and_node.second;
-                for (auto &node : nodes) {
-                    list->index.remove(node);
-                    recordMgr.retire_node(node);
-                }
+            for (auto storage : storages) {
+                storage->updateIndex(writeVersion, oldestSnapshot);
             }
         }
 
         // cleanup
 
-//        localStorage.queueMap.clear();
-        localStorage.writeSet.clear();
-        localStorage.readSet.clear();
-        localStorage.indexAdd.clear();
-        localStorage.indexRemove.clear();
+        for (auto storage : storages) {
+            if (abort) {
+                storage->recycle(); // the logs are cleared here, handle_abort won't see them
+            }
+            storage->endOp();
+            storage->clear();
+        }
+        storages.clear();
         local_transaction.TX = false;
         local_transaction.readOnly = true;
+        local_transaction.readOnlyMode = false;
 
 //        if (DEBUG_MODE_TX) {
 //            if (abort) {
@@ -252,32 +539,191 @@ public:
 //        }
 
         if (abort) {
-            throw TxAbortException();
+            recordAbort(site, reason);
+            return TxStatus::aborted(reason, site);
         }
 
-        return true;
+        return TxStatus::ok();
     }
 
-    template <typename key_t, typename val_t>
-    void handle_abort(const RecordMgr<key_t, val_t>& recordMgr) {
-        auto& localStorage = get_local_storge<key_t, val_t>();
+    // cleans up after an abort, of every structure the transaction touched
+    void handle_abort() {
         auto& local_transaction = get_local_transaction();
-
-        //remove the items we wanted to add
-        auto& indexMap = localStorage.indexAdd;
-        for (auto& list_and_node : indexMap) {
-            auto& list = list_and_node.first;
-            auto& nodes = list_and_node.second;
-            for (auto &node : nodes) {
-                recordMgr.retire_node(node);
+        for (auto storage : threadStorages()) {
+            if (!storage->isEmpty()) {
+                storage->recycle();
+                storage->clear();
             }
         }
 
-        localStorage.writeSet.clear();
-        localStorage.readSet.clear();
-        localStorage.indexAdd.clear();
-        localStorage.indexRemove.clear();
+        releaseQueues(local_transaction);
+        endSnapshot(local_transaction);
         local_transaction.TX = false;
         local_transaction.readOnly = true;
+        local_transaction.readOnlyMode = false;
+    }
+
+    template <typename key_t, typename val_t, typename... rm_params>
+    void handle_abort(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        setRecordMgr(recordMgr);
+        handle_abort();
     }
-};
\ No newline at end of file
+
+private:
+    CommitLockMode m_lock_mode;
+    uint32_t m_max_lock_spins;
+    std::atomic<uint64_t> m_aborts_avoided;
+    std::atomic<uint64_t> m_extensions;
+    std::atomic<uint64_t> m_failed_extensions;
+    std::atomic<uint64_t> m_extended_commits;
+    SnapshotRegistry m_snapshots;
+    ContentionManager m_contention;
+    std::atomic<uint64_t> m_run_aborts[N_ABORT_REASONS];
+    std::atomic<uint64_t> m_irrevocable_runs;
+
+    // the retry state of one TX::run, leaves the contention manager however run ends
+    class RunScope {
+    public:
+        explicit RunScope(BasicTX& tx) : m_tx(tx), m_stats(tx.get_local_transaction().lastRun),
+                                    m_active(false), m_irrevocable(false) {
+            m_stats = RunStats();
+        }
+
+        ~RunScope() {
+            exitAttempt();
+            if (m_irrevocable) {
+                m_tx.m_contention.exitIrrevocable();
+            }
+        }
+
+        RunScope(const RunScope&) = delete;
+
+        // backs off after an abort, then waits for (or takes) the irrevocable token
+        void enterAttempt(const RetryPolicy& policy) {
+            if (m_stats.attempts > 0 && !m_irrevocable) {
+                ContentionManager::spin(m_tx.m_contention.backoffSpins(policy, m_stats.attempts));
+            }
+            m_stats.attempts++;
+            if (m_irrevocable) {
+                return;
+            }
+            if (policy.irrevocable_after != 0 && m_stats.attempts > policy.irrevocable_after) {
+                m_tx.m_contention.enterIrrevocable();
+                m_irrevocable = true;
+                m_stats.irrevocable = true;
+                m_tx.m_irrevocable_runs++;
+                return;
+            }
+            m_tx.m_contention.enter();
+            m_active = true;
+        }
+
+        void onAbort(AbortReason reason) {
+            exitAttempt();
+            m_stats.aborts[static_cast<size_t>(reason)]++;
+            m_tx.m_run_aborts[static_cast<size_t>(reason)]++;
+            m_tx.m_contention.onAbort(m_stats.attempts);
+        }
+
+        void onCommit() {
+            m_tx.m_contention.onCommit(m_stats.attempts - 1);
+        }
+
+    private:
+        void exitAttempt() {
+            if (m_active) {
+                m_tx.m_contention.exit();
+                m_active = false;
+            }
+        }
+
+        BasicTX& m_tx;
+        RunStats& m_stats;
+        bool m_active;
+        bool m_irrevocable;
+    };
+
+    template <typename ret_t, typename op_t>
+    typename std::enable_if<!std::is_void<ret_t>::value, ret_t>::type
+    attempt(op_t& op, RunScope& scope) {
+        ret_t ret = op();
+        TXend();
+        scope.onCommit();
+        return ret;
+    }
+
+    template <typename ret_t, typename op_t>
+    typename std::enable_if<std::is_void<ret_t>::value>::type
+    attempt(op_t& op, RunScope& scope) {
+        op();
+        TXend();
+        scope.onCommit();
+    }
+
+    // the read sets of storages weren't written after readVersion, advances the clock like the read that saw it would
+    template <typename storages_t>
+    bool validateReadSets(const storages_t& storages, uint64_t owner, uint64_t readVersion, AbortReason& reason) {
+        uint64_t seenVersion = 0;
+        for (auto storage : storages) {
+            if (!storage->validateReadSet(owner, readVersion, reason, seenVersion)) {
+                if (reason == AbortReason::NEWER_VERSION) {
+                    onNewerVersion(seenVersion);
+                } else if (reason == AbortReason::SINGLETON_CONFLICT) {
+                    incrementAndGetVersion(); // increment GVC
+                }
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // the queues of the transaction weren't written after its read version
+    bool validateQueues(LocalTransaction& local_transaction, AbortReason& reason) {
+        for (auto queue : local_transaction.queues) {
+            uint64_t version_mask = queue->getVersionMask();
+            uint64_t version = QueueBase::versionOf(version_mask);
+            if (version > local_transaction.readVersion) {
+                onNewerVersion(version);
+                reason = AbortReason::NEWER_VERSION;
+                return false;
+            } else if (version == local_transaction.readVersion && QueueBase::isSingletonMask(version_mask)) {
+                incrementAndGetVersion(); // increment GVC
+                reason = AbortReason::SINGLETON_CONFLICT;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // the snapshot of the transaction no longer holds back the older versions
+    void endSnapshot(LocalTransaction& local_transaction) {
+        if (local_transaction.snapshot) {
+            m_snapshots.exit(local_transaction.ownerId);
+            local_transaction.snapshot = false;
+        }
+    }
+
+    // unlocks the queues of the transaction and drops their local queues
+    static void releaseQueues(LocalTransaction& local_transaction) {
+        for (auto queue : local_transaction.queues) {
+            queue->releaseLocal();
+        }
+        local_transaction.queues.clear();
+    }
+
+    // the typed entry points hand the record manager of their key and value types to the commit
+    template <typename key_t, typename val_t, typename... rm_params>
+    void setRecordMgr(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        static_assert(std::is_same<RecordMgr<key_t, val_t, rm_params...>, record_mgr_t<key_t, val_t>>::value,
+                      "recordMgr is not the record manager of the policy");
+        get_local_storge<key_t, val_t>().recordMgr = &recordMgr;
+    }
+
+    static void recordAbort(AbortSite site, AbortReason reason) {
+        if (Policy::ABORT_STATS) {
+            AbortStats::record(site, reason);
+        }
+    }
+};
+
+using TX = BasicTX<DefaultTxPolicy>;
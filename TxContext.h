@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+
+#include "LocalTransaction.h"
+#include "LocalStorage.h"
+#include "nodes/record_mgr.h"
+
+/**
+ * the running transaction as seen by the structures of one key and value type: the thread's transaction,
+ * its logs, the record manager and a copy of the read version. BasicTX::TXbegin(recordMgr) hands it out and the
+ * operations take it (LinkedList::get(ctx, key), ...), so their hot path reads the caller's context instead
+ * of looking up the thread local transaction and storage on every step.
+ * the context of TXbegin holds the guard of its record manager until the transaction commits or aborts.
+ */
+template <typename key_t, typename val_t, typename record_mgr_t = RecordMgr<key_t, val_t>>
+struct TxContext {
+    using storage_t = LocalStorage<key_t, val_t, record_mgr_t>;
+
+    LocalTransaction* transaction = nullptr;
+    storage_t* storage = nullptr;
+    const record_mgr_t* recordMgr = nullptr;
+    uint64_t readVersion = 0;
+
+    TxContext() = default;
+
+    TxContext(LocalTransaction& transaction, storage_t& storage, const record_mgr_t& recordMgr) :
+        transaction(&transaction),
+        storage(&storage),
+        recordMgr(&recordMgr),
+        readVersion(transaction.readVersion)
+    {
+        storage.recordMgr = &recordMgr; // TXend commits the storage with it
+    }
+};
+
+/**
+ * the guard of one operation that got no context (LinkedList::get(key, recordMgr), ...),
+ * unless the context of TXbegin holds the guard of the record manager already
+ */
+template <typename key_t, typename val_t, typename record_mgr_t = RecordMgr<key_t, val_t>>
+class OpGuard {
+public:
+    explicit OpGuard(const TxContext<key_t, val_t, record_mgr_t>& ctx) :
+        m_recordMgr(ctx.storage->guardHeld ? nullptr : ctx.recordMgr) {
+        if (m_recordMgr != nullptr) {
+            m_recordMgr->startOp();
+        }
+    }
+
+    ~OpGuard() {
+        if (m_recordMgr != nullptr) {
+            m_recordMgr->endOp();
+        }
+    }
+
+    OpGuard(const OpGuard&) = delete;
+
+private:
+    const record_mgr_t* m_recordMgr;
+};
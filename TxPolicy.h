@@ -0,0 +1,52 @@
+#pragma once
+
+#include "GlobalClock.h"
+#include "AbortStats.h"
+#include "nodes/record_mgr.h"
+
+/**
+ * how TXend acquires the locks of the write set
+ * TRY_ONCE    - in write set order, abort on the first lock that is taken
+ * SORTED_SPIN - in node address order (so committers can't wait on each other in a cycle),
+ *               spinning with exponential backoff up to max_lock_spins on a taken lock
+ */
+enum class CommitLockMode { TRY_ONCE, SORTED_SPIN };
+
+/**
+ * the compile time configuration of a BasicTX and of the structures on it (LinkedList, Queue, TxHashMap)
+ *  Clock            - the global version clock (GlobalClock.h)
+ *  LOCK_MODE        - how TXend locks the write set, unless the TX is constructed with another mode
+ *  ABORT_STATS      - count the aborts in AbortStats, false compiles the counting out
+ *  EXTEND_SNAPSHOT  - a read of a newer version extends the read version instead of aborting (BasicTX::extend)
+ *  MULTI_VERSION    - commits keep the older versions of the list nodes that running snapshots may read,
+ *                     so a read only transaction (TXbeginReadOnly) reads a snapshot and never aborts (VNode.h).
+ *                     the structures use the versioned_t of record_mgr then, its list nodes carry the chain
+ *  DEBUG_*          - trace the operations to std::cout
+ *  record_mgr<k, v> - the record manager of the structures, a RecordMgr with its reclaimer, allocator and pool
+ *                     (nodes/record_mgr.h)
+ * DefaultTxPolicy is the configuration of the build flags (GVC_*, NO_ABORT_STATS, RECLAIM_*, POOL_NONE).
+ * a policy derives from it and overrides what it changes, so several configurations live in one binary:
+ *     struct Gv4Policy : DefaultTxPolicy {
+ *         using Clock = GV4Clock;
+ *     };
+ *     BasicTX<Gv4Policy> tx;
+ *     LinkedList<size_t, size_t, Gv4Policy> list(tx, recordMgr);
+ * the node handles (UNSAFE, DEBRA or shared_ptr, see LNodeWrapper.h) stay a build flag,
+ * all the node, log and index types are built on them
+ */
+struct DefaultTxPolicy {
+    using Clock = GlobalClock;
+
+    static constexpr CommitLockMode LOCK_MODE = CommitLockMode::TRY_ONCE;
+    static constexpr bool ABORT_STATS = AbortStats::ENABLED;
+    static constexpr bool EXTEND_SNAPSHOT = true;
+    static constexpr bool MULTI_VERSION = false;
+
+    static constexpr bool DEBUG_LL = false;
+    static constexpr bool DEBUG_QUEUE = false;
+    static constexpr bool DEBUG_TX = false;
+    static constexpr bool DEBUG_VERSION = false;
+
+    template <typename key_t, typename val_t>
+    using record_mgr = RecordMgr<key_t, val_t>;
+};
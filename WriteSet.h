@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "FlatLog.h"
+#include "WriteElement.h"
+#include "nodes/LNodeWrapper.h"
+
+/**
+ * the transaction write set: node -> WriteElement.
+ * entries are kept in insertion order in a FlatLog. small write sets are searched linearly,
+ * once they grow past LINEAR_SCAN_MAX an open addressing index (linear probing) is built over the entries.
+ * clear() only bumps a stamp, so neither the entries nor the index are freed between transactions.
+ * a small bloom filter (signature) over the node addresses answers the common miss without a probe.
+ */
+template <typename key_t, typename val_t>
+class WriteSet {
+public:
+    using node_t = LNodeWrapper<key_t,val_t>;
+
+    struct Entry {
+        node_t node;
+        WriteElement<key_t, val_t> we;
+    };
+
+    using iterator = typename FlatLog<Entry>::iterator;
+
+    // lookup counters of this (thread local) write set, kept across transactions
+    struct FilterStats {
+        uint64_t lookups = 0;
+        uint64_t filtered = 0; // answered by the signature alone
+        uint64_t falsePositives = 0; // passed the signature but were not in the write set
+
+        double falsePositiveRate() const {
+            auto probed = lookups - filtered;
+            return probed == 0 ? 0.0 : static_cast<double>(falsePositives) / probed;
+        }
+    };
+
+    WriteSet() : m_signature(), m_stamp(1), m_indexed(false) {}
+
+    // returns the write element of node or nullptr if node is not in the write set
+    WriteElement<key_t, val_t>* find(const node_t& node) {
+        m_stats.lookups++;
+        if (!mayContain(mix(node))) {
+            m_stats.filtered++;
+            return nullptr;
+        }
+        auto we = probe(node);
+        if (we == nullptr) {
+            m_stats.falsePositives++;
+        }
+        return we;
+    }
+
+    void put(const node_t& node, const WriteElement<key_t, val_t>& we) {
+        auto existing = probe(node);
+        if (existing != nullptr) {
+            *existing = we;
+            return;
+        }
+        addToSignature(mix(node));
+        m_entries.push_back(Entry{node, we});
+        if (m_indexed) {
+            if (2 * m_entries.size() > m_table.size()) {
+                rebuild_index();
+            } else {
+                insert_to_index(m_entries.size() - 1);
+            }
+        } else if (m_entries.size() > LINEAR_SCAN_MAX) {
+            rebuild_index();
+        }
+    }
+
+    Entry& operator[](size_t i) {
+        return m_entries[i];
+    }
+
+    size_t size() const {
+        return m_entries.size();
+    }
+
+    bool empty() const {
+        return m_entries.empty();
+    }
+
+    void clear() {
+        m_entries.clear();
+        for (auto& w : m_signature) {
+            w = 0;
+        }
+        m_indexed = false;
+        if (++m_stamp == 0) {
+            // stamp wrapped around, old slots could look valid again
+            for (auto& s : m_table) {
+                s.stamp = 0;
+            }
+            m_stamp = 1;
+        }
+    }
+
+    const FilterStats& filterStats() const {
+        return m_stats;
+    }
+
+    iterator begin() { return m_entries.begin(); }
+    iterator end() { return m_entries.end(); }
+
+private:
+    static constexpr size_t LINEAR_SCAN_MAX = 16;
+    static constexpr size_t SIGNATURE_WORDS = 4; // 256 bits, two bits per node
+
+    struct Slot {
+        uint32_t idx = 0;
+        uint32_t stamp = 0; // the slot is in use only if stamp == m_stamp
+    };
+
+    static uint64_t mix(const node_t& node) {
+        // nodes are hashed by address, the low bits are alignment so mix them out
+        uint64_t h = node.hash();
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    bool mayContain(uint64_t h) const {
+        uint64_t b1 = h & 0xff;
+        uint64_t b2 = (h >> 8) & 0xff;
+        return (m_signature[b1 >> 6] & (1ULL << (b1 & 63))) != 0 &&
+               (m_signature[b2 >> 6] & (1ULL << (b2 & 63))) != 0;
+    }
+
+    void addToSignature(uint64_t h) {
+        uint64_t b1 = h & 0xff;
+        uint64_t b2 = (h >> 8) & 0xff;
+        m_signature[b1 >> 6] |= (1ULL << (b1 & 63));
+        m_signature[b2 >> 6] |= (1ULL << (b2 & 63));
+    }
+
+    WriteElement<key_t, val_t>* probe(const node_t& node) {
+        if (!m_indexed) {
+            for (size_t i = 0; i < m_entries.size(); i++) {
+                if (m_entries[i].node == node) {
+                    return &m_entries[i].we;
+                }
+            }
+            return nullptr;
+        }
+        size_t mask = m_table.size() - 1;
+        for (size_t pos = slot_of(node); ; pos = (pos + 1) & mask) {
+            const Slot& s = m_table[pos];
+            if (s.stamp != m_stamp) {
+                return nullptr;
+            }
+            if (m_entries[s.idx].node == node) {
+                return &m_entries[s.idx].we;
+            }
+        }
+    }
+
+    size_t slot_of(const node_t& node) const {
+        // the signature uses the low 16 bits of the mix, the index the high ones
+        return (mix(node) >> 16) & (m_table.size() - 1);
+    }
+
+    void insert_to_index(size_t idx) {
+        size_t mask = m_table.size() - 1;
+        size_t pos = slot_of(m_entries[idx].node);
+        while (m_table[pos].stamp == m_stamp) {
+            pos = (pos + 1) & mask;
+        }
+        m_table[pos].idx = static_cast<uint32_t>(idx);
+        m_table[pos].stamp = m_stamp;
+    }
+
+    void rebuild_index() {
+        size_t cap = m_table.empty() ? 4 * LINEAR_SCAN_MAX : m_table.size();
+        while (cap < 2 * m_entries.size()) {
+            cap *= 2;
+        }
+        if (cap != m_table.size()) {
+            m_table.assign(cap, Slot());
+            m_stamp = 1;
+        } else if (++m_stamp == 0) {
+            m_table.assign(cap, Slot());
+            m_stamp = 1;
+        }
+        for (size_t i = 0; i < m_entries.size(); i++) {
+            insert_to_index(i);
+        }
+        m_indexed = true;
+    }
+
+    FlatLog<Entry> m_entries;
+    uint64_t m_signature[SIGNATURE_WORDS];
+    FilterStats m_stats;
+    std::vector<Slot> m_table;
+    uint32_t m_stamp;
+    bool m_indexed;
+};
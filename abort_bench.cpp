@@ -0,0 +1,153 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "datatypes/LinkedList.h"
+
+/**
+ * abort path microbenchmark: the same transactions with the exception API (get, put, TXend) and with the
+ * status API (tryGet, tryPut, tryCommit), see TxStatus in TX.h
+ *   abort path - one thread, every transaction writes a few keys and then reads a node that is locked by
+ *                another owner, so every transaction aborts (the cost of one abort, throw and unwind included)
+ *   contended  - n_threads threads run 50% get / 50% put transactions on n_keys keys until they commit
+ * usage: abort_bench [n_threads] [n_keys] [n_tx_per_thread] [ops_per_tx]
+ */
+
+using list_t = LinkedList<size_t, size_t>;
+using record_mgr_t = RecordMgr<size_t, size_t>;
+
+struct Op {
+    bool put;
+    size_t key;
+};
+
+// one attempt of a transaction with the exception API, false if it aborted
+bool attemptWithExceptions(TX& tx, list_t& l, const std::vector<Op>& ops, const record_mgr_t& recordMgr) {
+    try {
+        tx.TXbegin();
+        for (auto& op : ops) {
+            if (op.put) {
+                l.put(op.key, op.key, recordMgr);
+            } else {
+                l.get(op.key, recordMgr);
+            }
+        }
+        tx.TXend<size_t, size_t>(recordMgr);
+        return true;
+    } catch (TxAbortException&) {
+        tx.handle_abort<size_t, size_t>(recordMgr);
+        return false;
+    }
+}
+
+// the same attempt with the status API
+bool attemptWithStatus(TX& tx, list_t& l, const std::vector<Op>& ops, const record_mgr_t& recordMgr) {
+    tx.TXbegin();
+    Optional<size_t> ret;
+    for (auto& op : ops) {
+        TxStatus status = op.put ? l.tryPut(op.key, op.key, ret, recordMgr) : l.tryGet(op.key, ret, recordMgr);
+        if (!status) {
+            tx.handle_abort<size_t, size_t>(recordMgr);
+            return false;
+        }
+    }
+    if (!tx.tryCommit(recordMgr)) {
+        tx.handle_abort<size_t, size_t>(recordMgr);
+        return false;
+    }
+    return true;
+}
+
+template <typename attempt_t>
+void benchAbortPath(const std::string& name, attempt_t attempt, size_t n_keys, size_t n_tx) {
+    auto global_record_mgr = record_mgr_t::make_record_mgr(1);
+    record_mgr_t record_mgr(global_record_mgr, 0);
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    list_t l(tx, record_mgr);
+    for (size_t k = 1; k <= n_keys; k++) {
+        l.put(k, k, record_mgr);
+    }
+    // the last node is locked by an owner no thread has, every read of it aborts
+    auto last = l.head;
+    while (last->m_next.is_not_null()) {
+        last = last->m_next;
+    }
+    last->tryLock(OwnerIds::MAX_ID);
+    std::vector<Op> ops = {{true, 1}, {true, n_keys / 2}, {false, n_keys}};
+
+    size_t aborts = 0;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < n_tx; i++) {
+        if (!attempt(*tx, l, ops, record_mgr)) {
+            aborts++;
+        }
+    }
+    std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start_time;
+    std::cout << name << ": " << aborts << " aborts, " << time.count() * 1e9 / n_tx << " ns/aborted transaction"
+              << std::endl;
+    last->unlock();
+    l.deinit_list(record_mgr);
+}
+
+template <typename attempt_t>
+void benchContended(const std::string& name, attempt_t attempt, size_t n_threads, size_t n_keys, size_t n_tx,
+                    size_t ops_per_tx) {
+    auto global_record_mgr = record_mgr_t::make_record_mgr(n_threads + 1);
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    record_mgr_t record_mgr(global_record_mgr, 0);
+    list_t l(tx, record_mgr);
+    for (size_t k = 1; k <= n_keys; k++) {
+        l.put(k, k, record_mgr);
+    }
+
+    std::atomic<size_t> aborts(0);
+    std::vector<std::thread> threads;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (size_t t = 0; t < n_threads; t++) {
+        threads.emplace_back([&, t] {
+            record_mgr_t thread_record_mgr(global_record_mgr, t + 1);
+            std::mt19937_64 rng(t + 1);
+            std::uniform_int_distribution<size_t> key_dist(1, n_keys);
+            std::vector<Op> ops(ops_per_tx);
+            size_t my_aborts = 0;
+            for (size_t i = 0; i < n_tx; i++) {
+                for (auto& op : ops) {
+                    op = {rng() % 2 == 0, key_dist(rng)};
+                }
+                while (!attempt(*tx, l, ops, thread_record_mgr)) {
+                    my_aborts++;
+                }
+            }
+            aborts += my_aborts;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start_time;
+    size_t commits = n_threads * n_tx;
+    std::cout << name << ": " << commits / time.count() << " commits/sec, "
+              << static_cast<double>(aborts) / commits << " aborts/commit" << std::endl;
+    l.deinit_list(record_mgr);
+}
+
+int main(int argc, char *argv[]) {
+    size_t n_threads = argc > 1 ? std::atoi(argv[1]) : 4;
+    size_t n_keys = argc > 2 ? std::atoi(argv[2]) : 16;
+    size_t n_tx = argc > 3 ? std::atoi(argv[3]) : 100000;
+    size_t ops_per_tx = argc > 4 ? std::atoi(argv[4]) : 4;
+
+    std::cout << "abort path, " << n_keys << " keys" << std::endl;
+    benchAbortPath("exceptions", attemptWithExceptions, n_keys, n_tx);
+    benchAbortPath("status", attemptWithStatus, n_keys, n_tx);
+
+    std::cout << "contended, " << n_threads << " threads, " << n_keys << " keys, " << ops_per_tx
+              << " ops per transaction" << std::endl;
+    benchContended("exceptions", attemptWithExceptions, n_threads, n_keys, n_tx, ops_per_tx);
+    benchContended("status", attemptWithStatus, n_threads, n_keys, n_tx, ops_per_tx);
+    return 0;
+}
@@ -39,7 +39,8 @@ private:
 public:
     lockfreeblockbag() {
         VERBOSE DEBUG std::cout<<"constructor lockfreeblockbag lockfree="<<head.is_lock_free()<<std::endl;
-        assert(head.is_lock_free());
+        // gcc's libatomic reports 16 byte atomics as not lock free even where it uses cmpxchg16b,
+        // and a lock would be fine here anyway (see above), so this isn't asserted
         head.store(tagged_ptr({NULL,0}));
     }
     ~lockfreeblockbag() {
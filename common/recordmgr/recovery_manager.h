@@ -19,12 +19,15 @@
 #include "globals.h"
 
 // for crash recovery
+// the key has to be the same in every translation unit, a static variable would not be
+inline pthread_key_t& recoveryPthreadKey() {
+    static pthread_key_t key;
+    return key;
+}
 /*PAD;*/
-static pthread_key_t pthreadkey;
 static struct sigaction ___act;
 static void *___singleton = NULL;
 /*PAD;*/
-extern pthread_key_t pthreadkey;
 extern struct sigaction ___act;
 extern void *___singleton;
 
@@ -58,7 +61,7 @@ template <class MasterRecordMgr>
 void crashhandler(int signum, siginfo_t *info, void *uctx) {
     MasterRecordMgr * const recordmgr = (MasterRecordMgr * const) ___singleton;
 #ifdef SIGHANDLER_IDENTIFY_USING_PTHREAD_GETSPECIFIC
-    int tid = (int) ((long) pthread_getspecific(pthreadkey));
+    int tid = (int) ((long) pthread_getspecific(recoveryPthreadKey()));
 #endif
     TRACE COUTATOMICTID("received signal "<<signum<<std::endl);
 
@@ -88,6 +91,9 @@ public:
     PAD;
     const int NUM_PROCESSES;
     const int neutralizeSignal;
+    // setjmpbuffers is static, so every translation unit has its own copy. the destructor may be
+    // instantiated in another translation unit than the constructor, so it frees its own buffers
+    sigjmp_buf *ownSetjmpbuffers;
     PAD;
     
     inline int getTidInefficient(const pthread_t me) {
@@ -122,7 +128,7 @@ public:
         return tid;
     }
     inline int getTid_pthread_getspecific() {
-        void * result = pthread_getspecific(pthreadkey);
+        void * result = pthread_getspecific(recoveryPthreadKey());
         if (!result) {
             assert(false);
             COUTATOMIC("ERROR: failed to get thread id using pthread_getspecific"<<std::endl);
@@ -141,10 +147,10 @@ public:
 
         // here, we use the fact that errno is defined to be a thread local variable
         errnoThreads[tid] = &errno;
-        if (pthread_setspecific(pthreadkey, (void*) (long) tid)) {
+        if (pthread_setspecific(recoveryPthreadKey(), (void*) (long) tid)) {
             COUTATOMIC("ERROR: failure of pthread_setspecific for tid="<<tid<<std::endl);
         }
-        const long __readtid = (long) ((int *) pthread_getspecific(pthreadkey));
+        const long __readtid = (long) ((int *) pthread_getspecific(recoveryPthreadKey()));
         VERBOSE DEBUG COUTATOMICTID("did pthread_setspecific, pthread_getspecific of "<<__readtid<<std::endl);
         assert(__readtid == tid);
     }
@@ -162,8 +168,9 @@ public:
     
     RecoveryMgr(const int numProcesses, const int _neutralizeSignal, MasterRecordMgr * const masterRecordMgr)
             : NUM_PROCESSES(numProcesses) , neutralizeSignal(_neutralizeSignal){
-        setjmpbuffers = new sigjmp_buf[numProcesses];
-        pthread_key_create(&pthreadkey, NULL);
+        ownSetjmpbuffers = new sigjmp_buf[numProcesses];
+        setjmpbuffers = ownSetjmpbuffers;
+        pthread_key_create(&recoveryPthreadKey(), NULL);
         
         if (MasterRecordMgr::supportsCrashRecovery()) {
             // set up crash recovery signal handling for this process
@@ -183,7 +190,7 @@ public:
         ___singleton = (void *) masterRecordMgr;
     }
     ~RecoveryMgr() {
-        delete[] setjmpbuffers;
+        delete[] ownSetjmpbuffers;
     }
 };
 
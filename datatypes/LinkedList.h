@@ -1,11 +1,15 @@
 #pragma once
 
 #include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "../nodes/LNode.h"
 #include "../nodes/Index.h"
 #include "../nodes/LNodeWrapper.h"
 #include "../LocalStorage.h"
+#include "../TxContext.h"
 #include "../WriteElement.h"
 #include "dummyIndex.h"
 #include "../TX.h"
@@ -20,122 +24,342 @@ LNodeWrapper<key_t,val_t> safe_get_next(const LNodeWrapper<key_t,val_t>& n) {
 }
 
 
-template <typename key_t, typename val_t>
+/**
+ * @tparam Policy  the configuration of the transactions (TxPolicy.h), the list runs on a BasicTX<Policy>
+ *                 and uses the policy's record manager
+ */
+template <typename key_t, typename val_t, typename Policy = DefaultTxPolicy>
 class LinkedList {
 public:
+    using tx_t = BasicTX<Policy>;
+    using record_mgr_t = typename tx_t::template record_mgr_t<key_t, val_t>;
     using node_t = LNodeWrapper<key_t,val_t>;
-    using index_t = Index<key_t, val_t>;
+    using index_t = Index<key_t, val_t, record_mgr_t>;
+    using context_t = TxContext<key_t, val_t, record_mgr_t>;
 
-    std::shared_ptr<TX> m_tx;
+    std::shared_ptr<tx_t> m_tx;
     node_t head;
     index_t index;
 
-    LinkedList(std::shared_ptr<TX> tx, const RecordMgr<key_t, val_t>& recordMgr) :
+    LinkedList(std::shared_ptr<tx_t> tx, const record_mgr_t& recordMgr) :
         m_tx(std::move(tx)),
         head(recordMgr.get_new_node(std::numeric_limits<key_t>::min(), val_t{})),
-        index(head)
+        index(head, recordMgr)
     { }
 
-    node_t getPredSingleton(const key_t& key) {
-        node_t pred = index.getPred(key);
+    node_t getPredSingleton(const key_t& key, const record_mgr_t& recordMgr) {
+        node_t pred = index.getPred(key, recordMgr);
         while (pred->isLockedOrDeleted()) {
             if (pred == head) {
                 return head;
             }
-            pred = index.getPred(pred->m_key);
+            pred = index.getPred(pred->m_key, recordMgr);
         }
         return pred;
     }
 
-    Optional<val_t> getVal(node_t n, LocalStorage<key_t, val_t>& localStorage) {
-        auto we_it = localStorage.writeSet.find(n);
-        if (we_it != localStorage.writeSet.end()) {
-            const auto& we = we_it->second;
-            return we.val;
+    // the value of n as of readVersion (or as written by this TX), a value changed after n was read aborts the TX
+    TxStatus tryGetVal(node_t n, context_t& ctx, Optional<val_t>& val) {
+        auto we = ctx.storage->writeSet.find(n);
+        if (we != nullptr) {
+            val = we->val;
+            return TxStatus::ok();
+        }
+        while (true) {
+            val = n->m_val;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            bool retry;
+            auto status = tryValidateNode(n, ctx, retry);
+            if (!retry) {
+                return status;
+            }
         }
-        return n->m_val;
     }
 
-    node_t getPred(key_t key, LocalStorage<key_t, val_t>& localStorage) {
-        node_t pred = index.getPred(key);
+    TxStatus tryGetPred(const key_t& key, context_t& ctx, node_t& pred) {
+        auto& recordMgr = *ctx.recordMgr;
+        pred = index.getPred(key, recordMgr);
         while (true) {
-            if (pred->isLocked() || pred->getVersion() > m_tx->get_local_transaction().readVersion) {
+            if (pred->isLocked() || pred->getVersion() > ctx.readVersion) {
+                if (tryExtend(pred, ctx)) {
+                    continue;
+                }
                 // abort TX
-                m_tx->get_local_transaction().TX = false;
-                throw TxAbortException();
+                m_tx->onNewerVersion(pred->getVersion());
+                return m_tx->abortStatus(AbortSite::LIST_GET_PRED, lockedOrNewer(pred));
             }
-            if (pred->isSameVersionAndSingleton(m_tx->get_local_transaction().readVersion)) {
+            if (pred->isSameVersionAndSingleton(ctx.readVersion)) {
                 // TODO in the case of a thread running singleton and then TX
                 // this TX will abort once but for no reason
                 m_tx->incrementAndGetVersion();
-                m_tx->get_local_transaction().TX = false;
-                throw TxAbortException();
+                return m_tx->abortStatus(AbortSite::LIST_GET_PRED, AbortReason::SINGLETON_CONFLICT);
             }
-            auto we_it = localStorage.writeSet.find(pred);
-            if (we_it != localStorage.writeSet.end()) {
-                const auto& we = we_it->second;
-                if (we.deleted) {
+            auto we = ctx.storage->writeSet.find(pred);
+            if (we != nullptr) {
+                if (we->deleted) {
                     // if you deleted it earlier
                     assert (pred != head);
-                    pred = index.getPred(pred->m_key);
+                    pred = index.getPred(pred->m_key, recordMgr);
                     continue;
                 }
             }
             if (pred->isDeleted()) {
                 assert (pred != head);
-                pred = index.getPred(pred->m_key);
+                pred = index.getPred(pred->m_key, recordMgr);
             } else {
-                return pred;
+                return TxStatus::ok();
             }
         }
     }
 
-    node_t getNext(node_t n, LocalStorage<key_t, val_t>& localStorage) {
+    TxStatus tryGetNext(node_t n, context_t& ctx, node_t& next) {
         // first try to read from private write set
-        auto we_it = localStorage.writeSet.find(n);
-        if (we_it != localStorage.writeSet.end()) {
-            const auto& we = we_it->second;
-            return we.next;
+        auto we = ctx.storage->writeSet.find(n);
+        if (we != nullptr) {
+            next = we->next;
+            return TxStatus::ok();
         }
 
         // because we don't read next and locked at once,
         // we first see if locked, then read next and then re-check locked
+        while (true) {
+            if (n->isLocked()) {
+                // abort TX
+                return m_tx->abortStatus(AbortSite::LIST_GET_NEXT, AbortReason::LOCKED);
+            }
+            next = safe_get_next(n);
+            if (n->isLocked() || n->getVersion() > ctx.readVersion) {
+                if (tryExtend(n, ctx)) {
+                    continue;
+                }
+                // abort TX
+                m_tx->onNewerVersion(n->getVersion());
+                return m_tx->abortStatus(AbortSite::LIST_GET_NEXT, lockedOrNewer(n));
+            }
+            if (n->isSameVersionAndSingleton(ctx.readVersion)) {
+                m_tx->incrementAndGetVersion();
+                return m_tx->abortStatus(AbortSite::LIST_GET_NEXT, AbortReason::SINGLETON_CONFLICT);
+            }
+            if (next.is_null()) {
+                return TxStatus::ok();
+            }
+            bool retry;
+            auto status = tryValidateNode(next, ctx, retry);
+            if (!retry) {
+                return status;
+            }
+        }
+    }
+
+    /**
+     * a node of ctx's transaction is newer than its read version: moves the read version forward
+     * (BasicTX::extend, or to the one another context of the transaction extended to already).
+     * true if the node can be read again at the new read version, false if the transaction has to abort
+     */
+    bool tryExtend(node_t& n, context_t& ctx) {
         if (n->isLocked()) {
-            // abort TX
-            m_tx->get_local_transaction().TX = false;
-            throw TxAbortException();
+            return false;
         }
-        auto next = safe_get_next(n);
-        if (n->isLocked() || n->getVersion() > m_tx->get_local_transaction().readVersion) {
+        uint64_t version = n->getVersion();
+        if (version <= ctx.readVersion) {
+            return false;
+        }
+        if (version > ctx.transaction->readVersion && !m_tx->extend(version)) {
+            return false;
+        }
+        ctx.readVersion = ctx.transaction->readVersion;
+        return true;
+    }
+
+    /**
+     * the read version of ctx moved (tryExtend) since the operation started at readVersion. the extension only
+     * validated the logged read set, the pred and next the operation found aren't logged yet and may be stale
+     * (a node removed or linked in between), so the operation starts over from tryFindNode
+     */
+    static bool extendedSince(const context_t& ctx, uint64_t readVersion) {
+        return ctx.readVersion != readVersion;
+    }
+
+    // tryValidateNode that extends the snapshot on a newer version, then retry is set and the caller reads n again
+    TxStatus tryValidateNode(node_t& n, context_t& ctx, bool& retry) {
+        retry = n->getVersion() > ctx.readVersion && tryExtend(n, ctx);
+        if (retry) {
+            return TxStatus::ok();
+        }
+        return tryValidateNode(n, ctx.readVersion);
+    }
+
+    // aborts the TX if n was changed (or is being changed) after the TX started
+    TxStatus tryValidateNode(node_t& n, uint64_t readVersion) {
+        if (n->isLocked() || n->getVersion() > readVersion) {
             // abort TX
-            m_tx->get_local_transaction().TX = false;
-            throw TxAbortException();
+            m_tx->onNewerVersion(n->getVersion());
+            return m_tx->abortStatus(AbortSite::LIST_VALIDATE, lockedOrNewer(n));
         }
-        if (n->isSameVersionAndSingleton(m_tx->get_local_transaction().readVersion)) {
+        if (n->isSameVersionAndSingleton(readVersion)) {
             m_tx->incrementAndGetVersion();
-            m_tx->get_local_transaction().TX = false;
-            throw TxAbortException();
+            return m_tx->abortStatus(AbortSite::LIST_VALIDATE, AbortReason::SINGLETON_CONFLICT);
         }
-        if(next.is_not_null()) {
-            if (next->isLocked() || next->getVersion() > m_tx->get_local_transaction().readVersion) {
-                // abort TX
-                m_tx->get_local_transaction().TX = false;
-                throw TxAbortException();
+        return TxStatus::ok();
+    }
+
+    void validateNode(node_t& n) {
+        m_tx->throwIfAborted(tryValidateNode(n, m_tx->get_local_transaction().readVersion));
+    }
+
+    // why a node that failed the locked or version check aborts the TX
+    static AbortReason lockedOrNewer(node_t& n) {
+        return n->isLocked() ? AbortReason::LOCKED : AbortReason::NEWER_VERSION;
+    }
+
+    // is n unlocked and not newer than readVersion, bumps the clock on a singleton write of the same version
+    bool isValidAt(node_t& n, uint64_t readVersion) {
+        if (n->isLocked() || n->getVersion() > readVersion) {
+            m_tx->onNewerVersion(n->getVersion());
+            return false;
+        }
+        if (n->isSameVersionAndSingleton(readVersion)) {
+            m_tx->incrementAndGetVersion();
+            return false;
+        }
+        return true;
+    }
+
+    // one attempt of rangeQuerySingleton, false if a node changed since the clock was read
+    bool tryRangeQuerySingleton(const key_t& lo, const key_t& hi, std::vector<std::pair<key_t, val_t>>& out,
+            const record_mgr_t& recordMgr) {
+        uint64_t readVersion = m_tx->getVersion();
+        auto n = getPredSingleton(lo, recordMgr);
+        while (true) {
+            if (!isValidAt(n, readVersion)) {
+                return false;
             }
-            if (next->isSameVersionAndSingleton(m_tx->get_local_transaction().readVersion)) {
-                m_tx->incrementAndGetVersion();
-                m_tx->get_local_transaction().TX = false;
-                throw TxAbortException();
+            auto next = safe_get_next(n);
+            Optional<val_t> val = n->m_val;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (!isValidAt(n, readVersion) || n->isDeleted()) {
+                return false;
+            }
+            if (n->m_key >= lo && n != head && val) {
+                out.emplace_back(n->m_key, val);
             }
+            if (next.is_null() || next->m_key > hi) {
+                return true;
+            }
+            n = next;
+        }
+    }
+
+    /**
+     * the state of n in the snapshot of readVersion (multi version policies, see VNode.h): its next and value,
+     * false if n didn't exist then (it was inserted after readVersion or removed before).
+     * waits out a write that holds the lock of n, a snapshot never aborts
+     */
+    bool readAt(node_t& n, uint64_t readVersion, node_t& next, Optional<val_t>& val) {
+        using lnode_t = LNode<key_t, val_t>;
+        while (true) {
+            uint64_t version_mask = n->getVersionMask();
+            if (lnode_t::isLockedMask(version_mask)) {
+                __asm__ __volatile__("pause;");
+                continue;
+            }
+            next = n->m_next;
+            val = n->m_val;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            auto versions = versionsOf(n).load(std::memory_order_acquire);
+            if (n->getVersionMask() != version_mask) {
+                continue;
+            }
+            if (lnode_t::versionOf(version_mask) <= readVersion) {
+                return !lnode_t::isDeletedMask(version_mask);
+            }
+            // the newest older version the snapshot can see, the ones it needs are kept (see pushVersion)
+            for (auto v = versions; v != nullptr; v = v->m_older.load(std::memory_order_acquire)) {
+                if (v->m_version <= readVersion) {
+                    next = v->m_next;
+                    val = v->m_val;
+                    return !v->m_deleted;
+                }
+            }
+            return false;
+        }
+    }
+
+    // the closest node before key (in the index) that exists in the snapshot of readVersion, and its next
+    node_t getPredAt(const key_t& key, uint64_t readVersion, const record_mgr_t& recordMgr, node_t& next) {
+        node_t pred = index.getPred(key, recordMgr);
+        Optional<val_t> val;
+        while (!readAt(pred, readVersion, next, val)) {
+            assert (pred != head);
+            pred = index.getPred(pred->m_key, recordMgr);
+        }
+        return pred;
+    }
+
+    // get in the snapshot of readVersion, the nodes after an existing one exist in the same snapshot
+    Optional<val_t> getAt(const key_t& key, uint64_t readVersion, const record_mgr_t& recordMgr) {
+        node_t next;
+        node_t n = getPredAt(key, readVersion, recordMgr, next);
+        Optional<val_t> val;
+        while (next.is_not_null() && next->m_key <= key) {
+            n = next;
+            bool exists = readAt(n, readVersion, next, val);
+            assert (exists);
+            (void) exists;
+            if (n->m_key == key) {
+                return val;
+            }
+        }
+        return NULLOPT;
+    }
+
+    // rangeQuery in the snapshot of readVersion
+    void rangeQueryAt(const key_t& lo, const key_t& hi, uint64_t readVersion, const record_mgr_t& recordMgr,
+            std::vector<std::pair<key_t, val_t>>& out) {
+        node_t next;
+        getPredAt(lo, readVersion, recordMgr, next);
+        Optional<val_t> val;
+        while (next.is_not_null() && next->m_key <= hi) {
+            node_t n = next;
+            bool exists = readAt(n, readVersion, next, val);
+            assert (exists);
+            (void) exists;
+            if (n->m_key >= lo && val) {
+                out.emplace_back(n->m_key, val);
+            }
+        }
+    }
+
+    // multi version policies keep the state of the locked node n that a singleton write at version replaces
+    void saveVersion(node_t& n, uint64_t version, uint64_t oldestSnapshot, const record_mgr_t& recordMgr) {
+        if (Policy::MULTI_VERSION) {
+            pushVersion(n, version, oldestSnapshot, recordMgr);
+        }
+    }
+
+    // a singleton insert of n after the locked pred, multi version policies version pred like a write of its next
+    void linkSingleton(node_t& pred, node_t& n, const record_mgr_t& recordMgr) {
+        uint64_t oldestSnapshot;
+        auto version = m_tx->singletonVersion(oldestSnapshot);
+        saveVersion(pred, version, oldestSnapshot, recordMgr);
+        n->setVersionAndSingletonNoLockAssert(version, true);
+        pred->m_next = n;
+        if (Policy::MULTI_VERSION) {
+            pred->setVersionAndSingleton(version, true);
+        }
+    }
+
+    void assertNotReadOnly(const context_t& ctx) {
+        if (ctx.transaction->readOnlyMode) {
+            throw std::logic_error("write operation in a transaction started with TXbeginReadOnly");
         }
-        return next;
     }
 
     //find a node if found return true, pred and the node otherwise false with pred as the one that should be bfore the node
-    std::tuple<bool, node_t, node_t> find_node_singelton(LocalStorage<key_t, val_t>& localStorage, const key_t& key) {
+    std::tuple<bool, node_t, node_t> find_node_singelton(const key_t& key, const record_mgr_t& recordMgr) {
         while (true) {
             bool startOver = false;
-            auto pred = getPredSingleton(key);
+            auto pred = getPredSingleton(key, recordMgr);
             if (pred->isLocked()) {
                 continue;
             }
@@ -184,33 +408,35 @@ public:
         }
     }
 
-    //find a node if found return true, pred and the node otherwise false
-    std::tuple<bool, node_t, node_t> find_node(LocalStorage<key_t, val_t>& localStorage, const key_t& key) {
-        auto pred = getPred(key, localStorage);
-        auto next = getNext(pred, localStorage);
-        bool found = false;
-
-        while (next.is_not_null()) {
+    //find a node if found is true, pred and the node otherwise false with pred and the node after key
+    TxStatus tryFindNode(context_t& ctx, const key_t& key, bool& found, node_t& pred, node_t& next) {
+        found = false;
+        auto status = tryGetPred(key, ctx, pred);
+        if (!status) {
+            return status;
+        }
+        status = tryGetNext(pred, ctx, next);
+        while (status && next.is_not_null()) {
             if (next->m_key == key) {
-                return std::make_tuple(true, pred, next);
+                found = true;
+                return status;
             } else if (next->m_key > key) {
-                return std::make_tuple(false, pred, next);
+                return status;
             } else {
                 pred = next;
-                next = getNext(pred, localStorage);
+                status = tryGetNext(pred, ctx, next);
             }
         }
-        return std::make_tuple(false, pred, next);
+        return status;
     }
 
-    Optional<val_t> putSingleton(key_t key, val_t val, const RecordMgr<key_t, val_t>& recordMgr) {
+    Optional<val_t> putSingleton(key_t key, val_t val, const record_mgr_t& recordMgr) {
         auto guard = recordMgr.getGuard();
-        auto& localStorage = m_tx->get_local_storge<key_t, val_t>();
         while (true) {
             bool found;
             node_t pred;
             node_t next;
-            std::tie(found, pred, next) =find_node_singelton(localStorage, key);
+            std::tie(found, pred, next) =find_node_singelton(key, recordMgr);
             if (found) {
                 // the key exists, change to new value
                 auto node = pred->m_next;
@@ -219,10 +445,13 @@ public:
                         node->unlock();
                         continue;
                     }
+                    uint64_t oldestSnapshot;
+                    auto version = m_tx->singletonVersion(oldestSnapshot);
+                    saveVersion(node, version, oldestSnapshot, recordMgr);
                     auto ret = node->m_val;
                     node->m_val = val;
                     node->setSingleton(true);
-                    node->setVersion(m_tx->getVersion());
+                    node->setVersion(version);
                     node->unlock();
                     return ret; // return previous value associated with key
                 } else {
@@ -237,10 +466,9 @@ public:
                     }
                     auto n = recordMgr.get_new_node(std::move(key), std::move(val));
                     n->m_next = pred->m_next;
-                    pred->m_next = n;
-                    n->setVersionAndSingletonNoLockAssert(m_tx->getVersion(), true);
+                    linkSingleton(pred, n, recordMgr);
                     pred->unlock();
-                    index.add(n);
+                    index.add(n, recordMgr);
                     return NULLOPT;
                 } else {
                     continue;
@@ -254,10 +482,9 @@ public:
                         continue;
                     }
                     auto n = recordMgr.get_new_node(std::move(key), std::move(val));
-                    pred->m_next = n;
-                    n->setVersionAndSingletonNoLockAssert(m_tx->getVersion(), true);
+                    linkSingleton(pred, n, recordMgr);
                     pred->unlock();
-                    index.add(n);
+                    index.add(n, recordMgr);
                     return NULLOPT;
                 }
             }
@@ -272,71 +499,112 @@ public:
     // mapping for key. (A null return can also indicate that the map previously
     // associated null with key, if the implementation supports null values.)
     // @throws NullPointerException if the specified key or value is null
-    Optional<val_t> put(key_t key, val_t val, const RecordMgr<key_t, val_t>& recordMgr) {
-        auto& localStorage = m_tx->get_local_storge<key_t, val_t>();
+    Optional<val_t> put(key_t key, val_t val, const record_mgr_t& recordMgr) {
+        Optional<val_t> ret;
+        m_tx->throwIfAborted(tryPut(std::move(key), std::move(val), ret, recordMgr));
+        return ret;
+    }
+
+    // put in the transaction of ctx (see TX::TXbegin(recordMgr))
+    Optional<val_t> put(context_t& ctx, key_t key, val_t val) {
+        Optional<val_t> ret;
+        m_tx->throwIfAborted(tryPut(ctx, std::move(key), std::move(val), ret));
+        return ret;
+    }
+
+    // put without the throw: an abort comes back as the status (see TxStatus), ret is set if it went through
+    TxStatus tryPut(key_t key, val_t val, Optional<val_t>& ret, const record_mgr_t& recordMgr) {
+        auto& transaction = m_tx->get_local_transaction();
         // SINGLETON
-        if (!m_tx->get_local_transaction().TX) {
-            return putSingleton(key, val, recordMgr);
+        if (!transaction.TX) {
+            ret = putSingleton(key, val, recordMgr);
+            return TxStatus::ok();
+        }
+        context_t ctx(transaction, m_tx->template get_local_storge<key_t, val_t>(), recordMgr);
+        OpGuard<key_t, val_t, record_mgr_t> guard(ctx);
+        return tryPut(ctx, std::move(key), std::move(val), ret);
+    }
+
+    TxStatus tryPut(context_t& ctx, key_t key, val_t val, Optional<val_t>& ret) {
+        auto& localStorage = *ctx.storage;
+        auto& recordMgr = *ctx.recordMgr;
+        // SINGLETON
+        if (!ctx.transaction->TX) {
+            ret = putSingleton(key, val, recordMgr);
+            return TxStatus::ok();
         }
         // TX
-        auto guard = recordMgr.getGuard();
-        m_tx->get_local_transaction().readOnly = false;
+        assertNotReadOnly(ctx);
+        ctx.transaction->readOnly = false;
         bool found;
         node_t next;
         node_t pred;
-        std::tie(found, pred, next) =find_node(localStorage, key);
+        Optional<val_t> predVal;
+        auto status = TxStatus::ok();
+        while (true) {
+            uint64_t readVersion = ctx.readVersion;
+            status = tryFindNode(ctx, key, found, pred, next);
+            if (status) {
+                status = found ? tryGetVal(next, ctx, ret) : tryGetVal(pred, ctx, predVal);
+            }
+            if (!status) {
+                return status;
+            }
+            if (!extendedSince(ctx, readVersion)) {
+                break;
+            }
+        }
 
         if (found) {
-            auto we_it = localStorage.writeSet.find(next);
-            if (we_it != localStorage.writeSet.end()) {
-                const auto& we = we_it->second;
-                localStorage.putIntoWriteSet(next, we.next, val, we.deleted);
+            auto we = localStorage.writeSet.find(next);
+            if (we != nullptr) {
+                localStorage.putIntoWriteSet(next, we->next, val, we->deleted);
             } else {
                 localStorage.putIntoWriteSet(next, next->m_next, val, false);
             }
             // add to read set
-            localStorage.readSet.emplace(next);
+            localStorage.readSet.push_back(next);
             if (m_tx->DEBUG_MODE_LL) {
                 std::cout << "put key " << key << ":" << std::endl;
                 //printWriteSet();
             }
-            return next->m_val;
+            return status;
         }
 
         // not found
-        auto n = recordMgr.get_new_node(std::move(key), std::move(val));
+        auto n = recordMgr.get_tx_node(std::move(key), std::move(val));
         n->m_next = next;
-        localStorage.putIntoWriteSet(pred, n, getVal(pred, localStorage), false);
+        localStorage.putIntoWriteSet(pred, n, predVal, false);
         //TODO make shared from this
-        localStorage.addToIndexAdd(this, n);
+        localStorage.addToIndexAdd(&index, n);
 
         // add to read set
-        localStorage.readSet.emplace(pred);
+        localStorage.readSet.push_back(pred);
 
         if (m_tx->DEBUG_MODE_LL) {
-            std::cout << "put key " << key  << ":" << std::endl;
+            std::cout << "put key " << n->m_key  << ":" << std::endl;
            // printWriteSet();
         }
 
-        return NULLOPT;
+        ret = NULLOPT;
+        return status;
     }
 
-    Optional<val_t> putIfAbsentSingleton(key_t key, val_t val, const RecordMgr<key_t, val_t>& recordMgr) {
+    Optional<val_t> putIfAbsentSingleton(key_t key, val_t val, const record_mgr_t& recordMgr) {
         auto guard = recordMgr.getGuard();
-        auto& localStorage = m_tx->get_local_storge<key_t, val_t>();
         while (true) {
             bool found;
             node_t next;
             node_t pred;
-            std::tie(found, pred, next) = find_node_singelton(localStorage, key);
+            std::tie(found, pred, next) = find_node_singelton(key, recordMgr);
             if (found) {
                 // the key exists, return value
                 auto node = pred->m_next;
-                if (next->key != key || node != next || node->isLockedOrDeleted()) {
+                if (next->m_key != key || node != next || node->isLockedOrDeleted()) {
                     continue;
                 }
                 // return previous value associated with key
-                return node.val;
+                return node->m_val;
             } else if (!next.is_null()) {
                 // key doesn't exist, perform insert
                 if (pred->tryLock()) {
@@ -346,10 +614,9 @@ public:
                     }
                     auto n = recordMgr.get_new_node(std::move(key), std::move(val));
                     n->m_next = pred->m_next;
-                    pred->m_next = n;
-                    n->setVersionAndSingletonNoLockAssert(m_tx->getVersion(), true);
+                    linkSingleton(pred, n, recordMgr);
                     pred->unlock();
-                    index.add(n);
+                    index.add(n, recordMgr);
                     return NULLOPT;
                 } else {
                     continue;
@@ -363,9 +630,9 @@ public:
                         continue;
                     }
                     auto n = recordMgr.get_new_node(std::move(key), std::move(val));
-                    pred->m_next = n;
+                    linkSingleton(pred, n, recordMgr);
                     pred->unlock();
-                    index.add(n);
+                    index.add(n, recordMgr);
                     return NULLOPT;
                 }
             }
@@ -379,45 +646,86 @@ public:
     // (A null return can also indicate that the map previously associated
     // null with the key, if the implementation supports null values.)
     // @throws NullPointerException if the specified key or value is null
-    Optional<val_t> putIfAbsent(key_t key, val_t val, const RecordMgr<key_t, val_t>& recordMgr) {
-        auto& localStorage = m_tx->get_local_storge<key_t, val_t>();
+    Optional<val_t> putIfAbsent(key_t key, val_t val, const record_mgr_t& recordMgr) {
+        Optional<val_t> ret;
+        m_tx->throwIfAborted(tryPutIfAbsent(std::move(key), std::move(val), ret, recordMgr));
+        return ret;
+    }
+
+    Optional<val_t> putIfAbsent(context_t& ctx, key_t key, val_t val) {
+        Optional<val_t> ret;
+        m_tx->throwIfAborted(tryPutIfAbsent(ctx, std::move(key), std::move(val), ret));
+        return ret;
+    }
 
+    TxStatus tryPutIfAbsent(key_t key, val_t val, Optional<val_t>& ret, const record_mgr_t& recordMgr) {
+        auto& transaction = m_tx->get_local_transaction();
         // SINGLETON
-        if (!m_tx->get_local_transaction().TX) {
-            return putIfAbsentSingleton(key, val, recordMgr);
+        if (!transaction.TX) {
+            ret = putIfAbsentSingleton(key, val, recordMgr);
+            return TxStatus::ok();
+        }
+        context_t ctx(transaction, m_tx->template get_local_storge<key_t, val_t>(), recordMgr);
+        OpGuard<key_t, val_t, record_mgr_t> guard(ctx);
+        return tryPutIfAbsent(ctx, std::move(key), std::move(val), ret);
+    }
+
+    TxStatus tryPutIfAbsent(context_t& ctx, key_t key, val_t val, Optional<val_t>& ret) {
+        auto& localStorage = *ctx.storage;
+        auto& recordMgr = *ctx.recordMgr;
+
+        // SINGLETON
+        if (!ctx.transaction->TX) {
+            ret = putIfAbsentSingleton(key, val, recordMgr);
+            return TxStatus::ok();
         }
 
         // TX
-        m_tx->get_local_transaction().readOnly = false;
-        auto guard = recordMgr.getGuard();
+        assertNotReadOnly(ctx);
+        ctx.transaction->readOnly = false;
         bool found;
         node_t pred;
         node_t next;
-        std::tie(found, pred, next) =find_node(localStorage, key);
+        Optional<val_t> predVal;
+        auto status = TxStatus::ok();
+        while (true) {
+            uint64_t readVersion = ctx.readVersion;
+            status = tryFindNode(ctx, key, found, pred, next);
+            if (status) {
+                status = found ? tryGetVal(next, ctx, ret) : tryGetVal(pred, ctx, predVal);
+            }
+            if (!status) {
+                return status;
+            }
+            if (!extendedSince(ctx, readVersion)) {
+                break;
+            }
+        }
 
         if (found) {
             // the key exists, return value
-            localStorage.readSet.emplace(next); // add to read set
-            return next.val;
+            localStorage.readSet.push_back(next); // add to read set
+            return status;
         }
 
         // not found
-        auto n = recordMgr.get_new_node(std::move(key), std::move(val));
+        auto n = recordMgr.get_tx_node(std::move(key), std::move(val));
         n->m_next = next;
-        localStorage.putIntoWriteSet(pred, n, getVal(pred, localStorage), false);
-        localStorage.addToIndexAdd(this, n);
-        localStorage.readSet.emplace(pred); // add to read set
-        return NULLOPT;
+        localStorage.putIntoWriteSet(pred, n, predVal, false);
+        localStorage.addToIndexAdd(&index, n);
+        localStorage.readSet.push_back(pred); // add to read set
+        ret = NULLOPT;
+        return status;
     }
 
-    Optional<val_t> removeSingleton(key_t key, const RecordMgr<key_t, val_t>& recordMgr) {
+    Optional<val_t> removeSingleton(key_t key, const record_mgr_t& recordMgr) {
         auto guard = recordMgr.getGuard();
-        auto& localStorage = m_tx->get_local_storge<key_t, val_t>();
+        auto& localStorage = m_tx->template get_local_storge<key_t, val_t>();
         while (true) {
             bool found;
             node_t pred;
             node_t next;
-            std::tie(found, pred, next) = find_node_singelton(localStorage, key);
+            std::tie(found, pred, next) = find_node_singelton(key, recordMgr);
             if (!found) {
                 return NULLOPT;
             }
@@ -436,12 +744,16 @@ public:
                 }
                 node_t toRemove;
                 Optional<val_t> valToRet;
+                uint64_t ver = 0;
+                uint64_t oldestSnapshot = 0;
                 if (next->tryLock()) {
                     toRemove = next;
+                    ver = m_tx->singletonVersion(oldestSnapshot);
+                    saveVersion(pred, ver, oldestSnapshot, recordMgr);
+                    saveVersion(toRemove, ver, oldestSnapshot, recordMgr);
                     valToRet = toRemove->m_val;
                     toRemove->m_val = NULLOPT; // for Index
                     pred->m_next = pred->m_next->m_next;
-                    auto ver = m_tx->getVersion();
                     toRemove->setVersionAndDeletedAndSingleton(ver, true, true);
                     pred->setVersionAndSingleton(ver, true);
                     if (m_tx->DEBUG_MODE_LL) {
@@ -453,8 +765,8 @@ public:
                 }
                 toRemove->unlock();
                 pred->unlock();
-                index.remove(toRemove);
-                recordMgr.retire_node(toRemove);
+                index.remove(toRemove, recordMgr);
+                localStorage.retireUnlinked(&index, toRemove, ver, oldestSnapshot, recordMgr);
                 return valToRet;
             } else {
                 if (m_tx->DEBUG_MODE_LL) {
@@ -470,74 +782,160 @@ public:
     // Returns the value to which this map previously associated the key,
     // or null if the map contained no mapping for the key.
     // @throws NullPointerException if the specified key is null
-    Optional<val_t> remove(key_t key, const RecordMgr<key_t, val_t>& recordMgr) {
-        auto& localStorage = m_tx->get_local_storge<key_t, val_t>();
+    Optional<val_t> remove(key_t key, const record_mgr_t& recordMgr) {
+        Optional<val_t> ret;
+        m_tx->throwIfAborted(tryRemove(std::move(key), ret, recordMgr));
+        return ret;
+    }
+
+    Optional<val_t> remove(context_t& ctx, key_t key) {
+        Optional<val_t> ret;
+        m_tx->throwIfAborted(tryRemove(ctx, std::move(key), ret));
+        return ret;
+    }
+
+    TxStatus tryRemove(key_t key, Optional<val_t>& ret, const record_mgr_t& recordMgr) {
+        auto& transaction = m_tx->get_local_transaction();
+        // SINGLETON
+        if (!transaction.TX) {
+            ret = removeSingleton(key, recordMgr);
+            return TxStatus::ok();
+        }
+        context_t ctx(transaction, m_tx->template get_local_storge<key_t, val_t>(), recordMgr);
+        OpGuard<key_t, val_t, record_mgr_t> guard(ctx);
+        return tryRemove(ctx, std::move(key), ret);
+    }
+
+    TxStatus tryRemove(context_t& ctx, key_t key, Optional<val_t>& ret) {
+        auto& localStorage = *ctx.storage;
         // SINGLETON
-        if (!m_tx->get_local_transaction().TX) {
-            return removeSingleton(key, recordMgr);
+        if (!ctx.transaction->TX) {
+            ret = removeSingleton(key, *ctx.recordMgr);
+            return TxStatus::ok();
         }
 
         // TX
 
-        m_tx->get_local_transaction().readOnly = false;
-        auto guard = recordMgr.getGuard();
+        assertNotReadOnly(ctx);
+        ctx.transaction->readOnly = false;
         bool found;
         node_t next;
         node_t pred;
-        std::tie(found, pred, next) =find_node(localStorage, key);
+        node_t nextNext;
+        Optional<val_t> predVal;
+        Optional<val_t> nextVal;
+        auto status = TxStatus::ok();
+        while (true) {
+            uint64_t readVersion = ctx.readVersion;
+            status = tryFindNode(ctx, key, found, pred, next);
+            if (status && found) {
+                status = tryGetNext(next, ctx, nextNext);
+                if (status) {
+                    status = tryGetVal(pred, ctx, predVal);
+                }
+                if (status) {
+                    status = tryGetVal(next, ctx, nextVal);
+                }
+            }
+            if (!status) {
+                return status;
+            }
+            if (!extendedSince(ctx, readVersion)) {
+                break;
+            }
+        }
 
         // add to read set
-        localStorage.readSet.emplace(pred);
-
+        localStorage.readSet.push_back(pred);
 
         if (found) {
-            localStorage.putIntoWriteSet(pred, getNext(next, localStorage), getVal(pred, localStorage), false);
-            localStorage.putIntoWriteSet(next, node_t(), getVal(next, localStorage), true);
+            localStorage.putIntoWriteSet(pred, nextNext, predVal, false);
+            localStorage.putIntoWriteSet(next, node_t(), nextVal, true);
             // add to read set
-            localStorage.readSet.emplace(next);
-            localStorage.addToIndexRemove(this, next);
-            auto we_it = localStorage.writeSet.find(next);
-            if (we_it != localStorage.writeSet.end()) {
-                const auto& we = we_it->second;
-                return we.val;
-            }
-            return next->m_val;
+            localStorage.readSet.push_back(next);
+            localStorage.addToIndexRemove(&index, next);
+            ret = nextVal;
+            return status;
         }
         //not found
-        return NULLOPT;
+        ret = NULLOPT;
+        return status;
     }
 
-    bool containsKey(key_t key, const RecordMgr<key_t, val_t>& recordMgr) {
+    bool containsKey(key_t key, const record_mgr_t& recordMgr) {
         return static_cast<bool>(get(std::move(key), recordMgr));
     }
 
-    Optional<val_t> getSingleton(key_t key, const RecordMgr<key_t, val_t>& recordMgr) {
+    Optional<val_t> getSingleton(key_t key, const record_mgr_t& recordMgr) {
         auto guard = recordMgr.getGuard();
-        auto& localStorage = m_tx->get_local_storge<key_t, val_t>();
         //TODO maybe only get pred is more efficent
         bool found;
         node_t next;
         node_t pred;
-        std::tie(found, pred, next) = find_node_singelton(localStorage, key);
+        std::tie(found, pred, next) = find_node_singelton(key, recordMgr);
         if(found) {
             return next->m_val;
         }
         return NULLOPT;
     }
 
-    Optional<val_t> get(key_t key, const RecordMgr<key_t, val_t>& recordMgr) {
-        auto& localStorage = m_tx->get_local_storge<key_t, val_t>();
+    Optional<val_t> get(key_t key, const record_mgr_t& recordMgr) {
+        Optional<val_t> ret;
+        m_tx->throwIfAborted(tryGet(std::move(key), ret, recordMgr));
+        return ret;
+    }
+
+    Optional<val_t> get(context_t& ctx, key_t key) {
+        Optional<val_t> ret;
+        m_tx->throwIfAborted(tryGet(ctx, std::move(key), ret));
+        return ret;
+    }
+
+    TxStatus tryGet(key_t key, Optional<val_t>& ret, const record_mgr_t& recordMgr) {
+        auto& transaction = m_tx->get_local_transaction();
+        // SINGLETON
+        if (!transaction.TX) {
+            ret = getSingleton(key, recordMgr);
+            return TxStatus::ok();
+        }
+        context_t ctx(transaction, m_tx->template get_local_storge<key_t, val_t>(), recordMgr);
+        OpGuard<key_t, val_t, record_mgr_t> guard(ctx);
+        return tryGet(ctx, std::move(key), ret);
+    }
+
+    TxStatus tryGet(context_t& ctx, key_t key, Optional<val_t>& ret) {
+        auto& localStorage = *ctx.storage;
         // SINGLETON
-        if (!m_tx->get_local_transaction().TX) {
-            return getSingleton(key, recordMgr);
+        if (!ctx.transaction->TX) {
+            ret = getSingleton(key, *ctx.recordMgr);
+            return TxStatus::ok();
+        }
+
+        // SNAPSHOT
+        if (ctx.transaction->snapshot) {
+            ret = getAt(key, ctx.readVersion, *ctx.recordMgr);
+            return TxStatus::ok();
         }
 
         // TX
-        auto guard = recordMgr.getGuard();
         bool found;
         node_t pred;
         node_t next;
-        std::tie(found, pred, next) =find_node(localStorage, key);
+        auto status = TxStatus::ok();
+        while (true) {
+            uint64_t readVersion = ctx.readVersion;
+            ret = NULLOPT;
+            status = tryFindNode(ctx, key, found, pred, next);
+            if (status && found) {
+                status = tryGetVal(next, ctx, ret);
+            }
+            if (!status) {
+                return status;
+            }
+            if (!extendedSince(ctx, readVersion)) {
+                break;
+            }
+        }
 
         if (m_tx->DEBUG_MODE_LL) {
             std::cout << "get key " << key << ":" << std::endl;
@@ -545,22 +943,122 @@ public:
 //            printWriteSet();
         }
 
+        if (ctx.transaction->readOnlyMode) {
+            // nothing is logged, every read was validated against readVersion as it happened
+            // (the value too, by tryGetVal, the write set is empty)
+            return status;
+        }
+
         // add to read set
-        localStorage.readSet.emplace(pred);
+        localStorage.readSet.push_back(pred);
         if(found) {
-            //TODO: this was a bug in java implmention we also need to check if there is a value update in the write set
-            auto we_it = localStorage.writeSet.find(next);
-            if (we_it != localStorage.writeSet.end()) {
-                const auto& we = we_it->second;
-                return we.val;
-            }
             assert (next->m_key == key);
-            return next->m_val;
+            localStorage.readSet.push_back(next); // its value, so a later write of it aborts (or fails an extension)
         }
-        return NULLOPT;
+        return status;
+    }
+
+    /**
+     * the keys in [lo, hi] and their values, in key order, into out (which is cleared first).
+     * in a transaction the range is walked once from the predecessor of lo. the predecessor and the nodes
+     * in the range are logged, so an insert into or removal from the range aborts the transaction
+     * (a read only transaction logs nothing, every node is validated as it's read)
+     * @return the number of keys found
+     */
+    size_t rangeQuery(const key_t& lo, const key_t& hi, std::vector<std::pair<key_t, val_t>>& out,
+            const record_mgr_t& recordMgr) {
+        m_tx->throwIfAborted(tryRangeQuery(lo, hi, out, recordMgr));
+        return out.size();
+    }
+
+    size_t rangeQuery(context_t& ctx, const key_t& lo, const key_t& hi,
+            std::vector<std::pair<key_t, val_t>>& out) {
+        m_tx->throwIfAborted(tryRangeQuery(ctx, lo, hi, out));
+        return out.size();
+    }
+
+    TxStatus tryRangeQuery(const key_t& lo, const key_t& hi, std::vector<std::pair<key_t, val_t>>& out,
+            const record_mgr_t& recordMgr) {
+        auto& transaction = m_tx->get_local_transaction();
+        // SINGLETON
+        if (!transaction.TX) {
+            out.clear();
+            rangeQuerySingleton(lo, hi, out, recordMgr);
+            return TxStatus::ok();
+        }
+        context_t ctx(transaction, m_tx->template get_local_storge<key_t, val_t>(), recordMgr);
+        OpGuard<key_t, val_t, record_mgr_t> guard(ctx);
+        return tryRangeQuery(ctx, lo, hi, out);
+    }
+
+    TxStatus tryRangeQuery(context_t& ctx, const key_t& lo, const key_t& hi,
+            std::vector<std::pair<key_t, val_t>>& out) {
+        out.clear();
+        // SINGLETON
+        if (!ctx.transaction->TX) {
+            rangeQuerySingleton(lo, hi, out, *ctx.recordMgr);
+            return TxStatus::ok();
+        }
+
+        // SNAPSHOT
+        if (ctx.transaction->snapshot) {
+            rangeQueryAt(lo, hi, ctx.readVersion, *ctx.recordMgr, out);
+            return TxStatus::ok();
+        }
+
+        // TX
+        auto& localStorage = *ctx.storage;
+        bool readOnlyMode = ctx.transaction->readOnlyMode;
+        bool found;
+        node_t pred;
+        node_t next;
+        auto status = TxStatus::ok();
+        uint64_t readVersion;
+        do {
+            readVersion = ctx.readVersion;
+            status = tryFindNode(ctx, lo, found, pred, next);
+            if (!status) {
+                return status;
+            }
+        } while (extendedSince(ctx, readVersion));
+        // from here every node is logged before the next one is read, an extension validates the path to it
+        if (!readOnlyMode) {
+            localStorage.readSet.push_back(pred);
+        }
+        while (next.is_not_null() && next->m_key <= hi) {
+            Optional<val_t> val;
+            status = tryGetVal(next, ctx, val);
+            if (!readOnlyMode) {
+                localStorage.readSet.push_back(next);
+            }
+            if (!status) {
+                return status;
+            }
+            if (val) {
+                out.emplace_back(next->m_key, val);
+            }
+            status = tryGetNext(next, ctx, next);
+            if (!status) {
+                return status;
+            }
+        }
+        return status;
+    }
+
+    /**
+     * a linearizable range query outside of a transaction: the nodes are read as of one read of the
+     * version clock, if any of them is newer (or locked) the scan starts over
+     */
+    size_t rangeQuerySingleton(const key_t& lo, const key_t& hi, std::vector<std::pair<key_t, val_t>>& out,
+            const record_mgr_t& recordMgr) {
+        auto guard = recordMgr.getGuard();
+        while (!tryRangeQuerySingleton(lo, hi, out, recordMgr)) {
+            out.clear();
+        }
+        return out.size();
     }
 
-    void deinit_list(const RecordMgr<key_t, val_t>& recordMgr) {
+    void deinit_list(const record_mgr_t& recordMgr) {
         auto guard = recordMgr.getGuard();
         auto prev = head;
         auto cur = prev->m_next;
@@ -569,9 +1067,11 @@ public:
             prev = cur;
             cur = prev->m_next;
         }
+        recordMgr.retire_node(prev); // the last node (or the head of an empty list)
+        index.deinit(recordMgr);
     }
 
-    friend std::ostream& operator<< (std::ostream& stream, const LinkedList<key_t, val_t>& list) {
+    friend std::ostream& operator<< (std::ostream& stream, const LinkedList& list) {
         auto cur = list.head;
         while(!cur.is_null()) {
             stream << "," << cur;
@@ -581,7 +1081,7 @@ public:
     }
 
 
-    key_t get_sum_key(const RecordMgr<key_t, val_t>& recordMgr) {
+    key_t get_sum_key(const record_mgr_t& recordMgr) {
         auto cur = head;
         key_t res = 0;
         while(!cur.is_null()) {
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cassert>
+#include <exception>
+#include <functional>
+
 #include "../nodes/QNode.h"
 
 class EmptyQueueException : public std::exception
@@ -10,58 +14,89 @@ class EmptyQueueException : public std::exception
     }
 };
 
+/**
+ * what a transaction did to one Queue: the values it enqueued (not visible to anyone else until commit)
+ * and how far into the shared queue it dequeued.
+ */
 template <typename val_t>
 class LocalQueue {
 public:
+    using qnode_t = QNode<val_t>;
+
+    // the enqueued nodes, spliced onto the tail of the shared queue at commit
+    qnode_t* m_head;
+    qnode_t* m_tail;
+    size_t m_size;
+
+    bool m_deq_started; // m_last_deq is valid
+    qnode_t* m_last_deq; // the last node dequeued from the shared queue (the current dummy if none), the new dummy at commit
+    size_t m_shared_deqs; // number of nodes dequeued from the shared queue
+    bool m_locked_by_me; // is the queue (not the local queue) locked by this transaction
+
+    // frees nodes through the RecordMgr of the thread that runs the transaction
+    std::function<void(qnode_t*)> m_free;
 
-    LocalQueue() : m_first_deq(true),
-        m_node_to_deq(),
-        m_is_locked_by_me(false),
-        m_head(QNode<val_t>()),
-        m_tail(QNode<val_t>()),
-        m_size(0) {
+    explicit LocalQueue(std::function<void(qnode_t*)> free_node) :
+        m_head(nullptr),
+        m_tail(nullptr),
+        m_size(0),
+        m_deq_started(false),
+        m_last_deq(nullptr),
+        m_shared_deqs(0),
+        m_locked_by_me(false),
+        m_free(std::move(free_node)) {}
+
+    ~LocalQueue() {
+        // whatever is still here was never committed
+        while (m_head != nullptr) {
+            auto next = m_head->m_next.load();
+            m_free(m_head);
+            m_head = next;
+        }
     }
 
-    void enqueue(val_t val) {
-        QNode<val_t> node(val, m_tail, NULLOPT);
-        m_size++;
-        if (!m_tail) {
-            m_tail = node;
-            m_head = node;
+    LocalQueue(const LocalQueue&) = delete;
+    LocalQueue& operator=(const LocalQueue&) = delete;
 
+    void enqueue(qnode_t* node) {
+        if (m_tail == nullptr) {
+            m_head = node;
         } else {
-            m_tail.m_next = node;
-            m_tail = node;
+            m_tail->m_next = node;
         }
+        m_tail = node;
+        m_size++;
     }
 
-    val_t dequeue(){
-        if (!m_head) {
+    val_t dequeue() {
+        if (m_head == nullptr) {
             throw EmptyQueueException();
         }
-        auto temp = m_head;
-        auto ret = temp.val;
-        m_head = m_head.next;
-        if (!m_head) {
-            m_tail = NULLOPT;
-        } else {
-            m_head.prev = NULLOPT;
+        auto node = m_head;
+        val_t ret = node->m_val;
+        m_head = node->m_next;
+        if (m_head == nullptr) {
+            m_tail = nullptr;
         }
         m_size--;
+        m_free(node);
         return ret;
     }
 
-    bool isEmpty() {
-        assert(m_size >= 0 && "LocalQueue size is negative");
-        return !m_size;
+    bool isEmpty() const {
+        assert((m_size == 0) == (m_head == nullptr) && "LocalQueue size doesn't match its nodes");
+        return m_size == 0;
     }
 
+    // did the transaction change the shared queue
+    bool changed() const {
+        return m_shared_deqs > 0 || m_size > 0;
+    }
 
-private:
-    bool m_first_deq; // is this the first time of a dequeue?
-    QNode<val_t> m_node_to_deq; // the node to dequeue
-    bool m_is_locked_by_me; // is queue (not local queue) locked by me
-    QNode<val_t> m_head;
-    QNode<val_t> m_tail;
-    int m_size;
+    // the nodes now belong to the shared queue
+    void releaseNodes() {
+        m_head = nullptr;
+        m_tail = nullptr;
+        m_size = 0;
+    }
 };
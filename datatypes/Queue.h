@@ -1,47 +1,58 @@
 #pragma once
 
-#include <mutex>
+#include <algorithm>
 #include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
 
 #include "../nodes/QNode.h"
 #include "../LocalStorage.h"
+#include "QueueBase.h"
 #include "LocalQueue.h"
 #include "../TX.h"
 
-template <typename val_t>
-class Queue {
+/**
+ * a transactional FIFO queue.
+ * in a transaction enqueue only appends to the thread's LocalQueue, dequeue and isEmpty lock the queue
+ * until TXend (the head can't be read speculatively). TXend locks the queues the transaction only enqueued to,
+ * validates their versions and splices each LocalQueue onto the shared tail in one step.
+ *
+ * outside of a transaction every operation is a singleton operation, done Michael-Scott style on the same
+ * nodes (m_head points to a dummy node). singleton operations don't wait for each other, only for a transaction
+ * that holds the queue lock: m_singletons counts the singleton operations in flight, a transaction that took the
+ * lock waits for it to drain, and a singleton operation that finds the queue locked backs off until it is unlocked.
+ *
+ * dequeued nodes stay linked from m_reclaim_from up to m_head. they are freed when nobody can be reading them:
+ * by a singleton operation that finds itself the only one in flight, or by a commit (which holds the lock).
+ * the queue runs on a BasicTX<Policy> (TxPolicy.h), its nodes come from any record manager with its val_t.
+ */
+template <typename val_t, typename Policy = DefaultTxPolicy>
+class Queue : public QueueBase {
 public:
-    // TODO : replace all QNode with QNode wrapper
-    std::shared_ptr<TX> m_tx;
-    QNode<val_t> m_head;
-    QNode<val_t> m_tail;
-    int m_size;
-    static constexpr uint64_t LOCK_MASK = 0x1000000000000000L;
-    static constexpr uint64_t SINGLETON_MASK = 0x4000000000000000L;
-    static constexpr uint64_t VERSIONNEG_MASK = LOCK_MASK | SINGLETON_MASK;
-
-    std::atomic<uint64_t> m_version_mask;
-
-    explicit Queue(std::shared_ptr<TX> tx) :
-    m_tx(std::move(tx)),
-    m_size(0),
-    m_head(NULLOPT),
-    m_tail(NULLOPT),
-    m_version_mask(0)
-    { }
+    using qnode_t = QNode<val_t>;
+    using tx_t = BasicTX<Policy>;
 
-    bool operator==(const Queue<val_t>& other) const {
-        return std::tie(m_tx.get(), m_size, m_head, m_tail, m_version_mask) ==
-                std::tie(other.m_tx.get(), other.m_size, other.m_head, other.m_tail, other.m_version_mask);
-    }
+    std::shared_ptr<tx_t> m_tx;
 
-    bool operator!=(const LNodeWrapper<key_t, val_t>& other) const{
-        return std::tie(m_tx.get(), m_size, m_head, m_tail, m_version_mask) !=
-               std::tie(other.m_tx.get(), other.m_size, other.m_head, other.m_tail, other.m_version_mask);
+    template <typename key_t, typename... rm_params>
+    Queue(std::shared_ptr<tx_t> tx, const RecordMgr<key_t, val_t, rm_params...>& recordMgr) :
+    m_tx(std::move(tx)),
+    m_singletons(0),
+    m_size(0)
+    {
+        qnode_t* dummy = recordMgr.get_new_qnode(val_t{});
+        m_head = dummy;
+        m_tail = dummy;
+        m_reclaim_from = dummy;
     }
 
+    Queue(const Queue&) = delete;
+    Queue& operator=(const Queue&) = delete;
+
     uint64_t getVersion() {
-        return (m_version_mask & (~VERSIONNEG_MASK));
+        return versionOf(m_version_mask);
     }
 
     void setVersion(uint64_t version) {
@@ -53,7 +64,7 @@ public:
     }
 
     bool isSingleton() {
-        return (m_version_mask & SINGLETON_MASK) != 0;
+        return isSingletonMask(m_version_mask);
     }
 
     void setSingleton(bool value) {
@@ -67,19 +78,25 @@ public:
         m_version_mask = l;
     }
 
-    bool tryLock() {
+    /**
+     * see LNode::tryLock. only transactions lock the queue, the version word may still change
+     * under a singleton operation until the lock is taken
+     */
+    bool tryLock(uint64_t owner) {
         uint64_t l = m_version_mask;
-        if ((l & LOCK_MASK) != 0) {
-            return false;
+        while ((l & LOCK_MASK) == 0) {
+            uint64_t locked = l | LOCK_MASK | (owner << OWNER_SHIFT);
+            if (m_version_mask.compare_exchange_weak(l, locked)) {
+                return true;
+            }
         }
-        uint64_t locked = l | LOCK_MASK;
-        return m_version_mask.compare_exchange_strong(l, locked);
+        return false;
     }
 
     void unlock() {
         uint64_t l = m_version_mask;
         assert ((l & LOCK_MASK) != 0 && "unlocking queue that is not locked");
-        uint64_t  unlocked = l & (~LOCK_MASK);
+        uint64_t  unlocked = l & (~(LOCK_MASK | OWNER_MASK));
         bool ret = m_version_mask.compare_exchange_strong(l, unlocked);
         assert (ret && "compare_exchange_strong in unlock queue failed");
     }
@@ -90,26 +107,16 @@ public:
     }
 
     void validateTxSafe() {
-        if (m_tx->get_local_transaction().readVersion < getVersion()) {
-            // abort TX
-            m_tx->get_local_transaction().TX = false;
-            throw TxAbortException();
-        }
-        if (m_tx->get_local_transaction().readVersion == getVersion() && isSingleton()) {
-            // TODO in the case of a thread running singleton and then TX
-            // this TX will abort once but for no reason
-            m_tx->incrementAndGetVersion();
-            m_tx->get_local_transaction().TX = false;
-            throw TxAbortException();
-        }
+        validateTxSafe(m_version_mask);
     }
 
-    void enqueue(val_t val) {
-        auto& localStorage = m_tx->get_local_storge<key_t, val_t>();
+    template <typename key_t, typename... rm_params>
+    void enqueue(val_t val, const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        auto& local_transaction = m_tx->get_local_transaction();
 
         // SINGLETON
-        if (!m_tx->get_local_transaction().TX) {
-            return enqueueSingleton(val);
+        if (!local_transaction.TX) {
+            return enqueueSingleton(std::move(val), recordMgr);
         }
 
         // TX
@@ -117,47 +124,51 @@ public:
             std::cout << "Queue enqueue - in TX" << std::endl;
         }
 
+        assertNotReadOnly();
         validateTxSafe();
 
-        auto q_map = localStorage.queueMap;
-        auto l_queue = q_map.find(this);
-        if (!l_queue) {
-            l_queue = LocalQueue<val_t>(); // TODO: validate this is the right way
-        }
-        l_queue.enqueue(val);
-        q_map.put(this, l_queue);
+        getLocalQueue(recordMgr).enqueue(recordMgr.get_new_qnode(std::move(val)));
+        local_transaction.readOnly = false;
     }
 
-    void enqueueSingleton(val_t val) {
-        std::shared_ptr<QNode<val_t>> node = std::make_shared<QNode<val_t>>(val);
+    template <typename key_t, typename... rm_params>
+    void enqueueSingleton(val_t val, const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        qnode_t* node = recordMgr.get_new_qnode(std::move(val));
+        enterSingleton();
+        if (m_tx->DEBUG_MODE_QUEUE) {
+            std::cout << "enqueueSingleton: val " << node->m_val << std::endl;
+        }
         while (true) {
-            if (tryLock()) {
-                if (m_tx->DEBUG_MODE_QUEUE) {
-                    std::cout << "enqueueSingleton: val " << val << std::endl;
-                }
-                if (!m_tail) {
-                    m_tail = node;
-                    m_head = node;
-                } else {
-                    m_tail.m_next = node;
-                    node.m_prev = m_tail;
-                    m_tail = node;
+            qnode_t* tail = m_tail;
+            qnode_t* next = tail->m_next;
+            if (tail != m_tail) {
+                continue;
+            }
+            if (next == nullptr) {
+                if (tail->m_next.compare_exchange_strong(next, node)) {
+                    m_tail.compare_exchange_strong(tail, node);
+                    break;
                 }
-                m_size++;
-                setVersion(m_tx->getVersion());
-                setSingleton(true);
-                unlock();
-                return;
+            } else {
+                // the tail is behind, help the other enqueue
+                m_tail.compare_exchange_strong(tail, next);
             }
         }
+        m_size++;
+        markSingletonWrite();
+        exitSingleton(recordMgr);
     }
 
-    val_t dequeue() {
-        auto& localStorage = m_tx->get_local_storge<key_t, val_t>();
+    /**
+     * @throws EmptyQueueException if the queue (as the transaction sees it) is empty, the transaction stays alive
+     */
+    template <typename key_t, typename... rm_params>
+    val_t dequeue(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        auto& local_transaction = m_tx->get_local_transaction();
 
         // SINGLETON
-        if (!m_tx->get_local_transaction().TX) {
-            return dequeueSingleton();
+        if (!local_transaction.TX) {
+            return dequeueSingleton(recordMgr);
         }
 
         // TX
@@ -165,81 +176,71 @@ public:
             std::cout << "Queue dequeue - in TX" << std::endl;
         }
 
-        validateTxSafe();
+        assertNotReadOnly();
+        auto& l_queue = lockForTx(recordMgr);
 
-        if (!tryLock()) {
-            // queue is locked by another thread - abort
-            m_tx->get_local_transaction().TX = false;
-            throw TxAbortException();
+        if (!l_queue.m_deq_started) {
+            l_queue.m_deq_started = true;
+            l_queue.m_last_deq = m_head;
         }
 
-        // now queue is locked
-        auto q_map = localStorage.queueMap;
-        auto l_queue = q_map.find(this);
-        if (!l_queue) {
-            l_queue = LocalQueue<val_t>(); // TODO: validate this is the right way
-        }
-        if (l_queue.m_first_deq) {
-            if (m_tx->DEBUG_MODE_QUEUE) {
-                std::cout << "Queue dequeue - first dequeue" << std::endl;
-            }
-            l_queue.m_first_deq = false;
-            l_queue.m_node_to_deq = m_head;
-        } else if (l_queue.m_node_to_deq) {
-            l_queue.m_node_to_deq = l_queue.m_node_to_deq.m_next;
-        }
-
-        if (l_queue.m_node_to_deq) { // dequeue from the queue
-            auto ret = l_queue.m_node_to_deq.m_val;
-            q_map.put(this, l_queue);
-            unlock(); // TODO: necessary?
-            return ret;
+        qnode_t* next = l_queue.m_last_deq->m_next;
+        if (next != nullptr) { // dequeue from the queue
+            l_queue.m_last_deq = next;
+            l_queue.m_shared_deqs++;
+            local_transaction.readOnly = false;
+            return next->m_val;
         }
 
         if (m_tx->DEBUG_MODE_QUEUE) {
             std::cout << "Queue dequeue - nodeToDeq is null" << std::endl;
         }
 
-        // there is no node in queue, then try the localQueue
-        q_map.put(this, l_queue);
-        unlock(); // TODO: necessary?
-        return l_queue.dequeue(); // can throw an exception
+        // there is no node left in the queue, then try the localQueue
+        val_t ret = l_queue.dequeue(); // can throw an exception
+        local_transaction.readOnly = false;
+        return ret;
     }
 
-    val_t dequeueSingleton() {
+    template <typename key_t, typename... rm_params>
+    val_t dequeueSingleton(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        enterSingleton();
+        if (m_tx->DEBUG_MODE_QUEUE) {
+            std::cout << "dequeueSingleton:" << std::endl;
+        }
         while (true) {
-            if (tryLock()) {
-                if (m_tx->DEBUG_MODE_QUEUE) {
-                    std::cout << "dequeueSingleton:" << std::endl;
-                }
-                if (!m_head) {
-                    unlock();
+            qnode_t* head = m_head;
+            qnode_t* tail = m_tail;
+            qnode_t* next = head->m_next;
+            if (head != m_head) {
+                continue;
+            }
+            if (head == tail) {
+                if (next == nullptr) {
+                    exitSingleton(recordMgr);
                     throw EmptyQueueException();
                 }
-
-                auto node = m_head;
-                auto ret = node.m_val;
-                m_head = m_head.m_next;
-                if (!m_head) {
-                    m_tail = NULLOPT;
-                } else {
-                    m_head.m_prev = NULLOPT;
-                }
+                m_tail.compare_exchange_strong(tail, next);
+                continue;
+            }
+            val_t ret = next->m_val;
+            if (m_head.compare_exchange_strong(head, next)) {
+                // head is the old dummy, freed once no one in flight can be reading it
                 m_size--;
-                setVersion(m_tx->getVersion());
-                setSingleton(true);
-                unlock();
-                return;
+                markSingletonWrite();
+                exitSingleton(recordMgr);
+                return ret;
             }
         }
     }
 
-    bool isEmpty() {
-        auto& localStorage = m_tx->get_local_storge<key_t, val_t>();
+    template <typename key_t, typename... rm_params>
+    bool isEmpty(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        auto& local_transaction = m_tx->get_local_transaction();
 
         // SINGLETON
-        if (!m_tx->get_local_transaction().TX) {
-            return isEmptySingleton();
+        if (!local_transaction.TX) {
+            return isEmptySingleton(recordMgr);
         }
 
         // TX
@@ -247,64 +248,243 @@ public:
             std::cout << "Queue is_empty - in TX" << std::endl;
         }
 
-        validateTxSafe();
+        if (local_transaction.readOnlyMode) {
+            // nothing to unlock at the end of a read only transaction, read like a singleton operation
+            // and abort if a transaction or another singleton operation is in the middle of a change
+            if (!tryEnterSingleton()) {
+                m_tx->abort(AbortSite::QUEUE_READ_ONLY, AbortReason::LOCKED);
+            }
+            bool empty = m_head.load()->m_next == nullptr;
+            bool alone = m_singletons == 1;
+            uint64_t version_mask = m_version_mask;
+            exitSingleton(recordMgr);
+            if (!alone) {
+                m_tx->abort(AbortSite::QUEUE_READ_ONLY, AbortReason::SINGLETON_CONFLICT);
+            }
+            validateTxSafe(version_mask);
+            return empty;
+        }
+
+        auto& l_queue = lockForTx(recordMgr);
+        qnode_t* last = l_queue.m_deq_started ? l_queue.m_last_deq : m_head.load();
+        return last->m_next == nullptr && l_queue.isEmpty();
+    }
 
-        if (!tryLock()) {
-            // queue is locked by another thread - abort
-            if (m_tx->DEBUG_MODE_QUEUE) {
-                std::cout << "Queue is_empty - couldn't lock" << std::endl;
+    template <typename key_t, typename... rm_params>
+    bool isEmptySingleton(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        enterSingleton();
+        bool empty = m_head.load()->m_next == nullptr;
+        exitSingleton(recordMgr);
+        return empty;
+    }
+
+    // number of values in the queue, exact only when no operation is running
+    size_t get_size() const {
+        return m_size;
+    }
+
+    // frees all the nodes, no operation may run concurrently or after
+    template <typename key_t, typename... rm_params>
+    void deinit_queue(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        qnode_t* cur = m_reclaim_from;
+        while (cur != nullptr) {
+            qnode_t* next = cur->m_next;
+            recordMgr.free_qnode(cur);
+            cur = next;
+        }
+        m_head = nullptr;
+        m_tail = nullptr;
+        m_reclaim_from = nullptr;
+    }
+
+    bool lockForCommit(uint64_t owner) override {
+        auto& l_queue = localQueues().at(this);
+        if (!l_queue.m_locked_by_me) {
+            if (!lockAndDrain(owner)) {
+                return false;
             }
-            m_tx->get_local_transaction().TX = false;
-            throw TxAbortException();
+            l_queue.m_locked_by_me = true;
+        }
+        return true;
+    }
+
+    void commitLocal(uint64_t writeVersion) override {
+        auto& l_queue = localQueues().at(this);
+        assert(l_queue.m_locked_by_me && "commit of a queue that is not locked");
+        if (!l_queue.changed()) {
+            return;
+        }
+        // no singleton operation is in flight, but the last one may have left the tail behind
+        qnode_t* tail = m_tail;
+        while (tail->m_next != nullptr) {
+            tail = tail->m_next;
+        }
+        if (l_queue.m_shared_deqs > 0) {
+            m_head = l_queue.m_last_deq;
         }
+        if (!l_queue.isEmpty()) {
+            // splice the whole local queue onto the tail
+            tail->m_next = l_queue.m_head;
+            tail = l_queue.m_tail;
+        }
+        m_tail = tail;
+        m_size += l_queue.m_size - l_queue.m_shared_deqs;
+        l_queue.releaseNodes();
+        freeRetired(l_queue.m_free);
+        setVersion(writeVersion);
+        setSingleton(false);
+    }
 
-        // now we have the lock
-        if (m_size > 0) {
+    void releaseLocal() override {
+        auto& l_queues = localQueues();
+        auto it = l_queues.find(this);
+        if (it == l_queues.end()) {
+            return;
+        }
+        if (it->second.m_locked_by_me) {
             unlock();
-            return false;
         }
+        l_queues.erase(it);
+    }
 
-        // check local queue
-        auto q_map = localStorage.queueMap;
-        auto l_queue = q_map.find(this);
-        if (!l_queue) {
-            l_queue = LocalQueue<val_t>(); // TODO: validate this is the right way
+    friend std::ostream& operator<< (std::ostream& stream, const Queue<val_t>& queue) {
+        qnode_t* cur = queue.m_head.load()->m_next;
+        while(cur != nullptr) {
+            stream << "," << cur->m_val;
+            cur = cur->m_next;
         }
-        q_map.put(this, l_queue);
-        unlock(); // TODO: necessary?
-        return l_queue.isEmpty();
+        return stream;
+    }
 
+private:
+    std::atomic<qnode_t*> m_head; // the dummy node, the first value is in m_head->m_next
+    std::atomic<qnode_t*> m_tail;
+    qnode_t* m_reclaim_from; // the oldest dequeued node not freed yet (m_head if none)
+    std::atomic<uint32_t> m_singletons; // singleton operations in flight
+    std::atomic<size_t> m_size;
+
+    // the local queues of this thread's transaction, by queue
+    static std::unordered_map<const Queue*, LocalQueue<val_t>>& localQueues() {
+        static thread_local std::unordered_map<const Queue*, LocalQueue<val_t>> l_queues;
+        return l_queues;
     }
 
-    bool isEmptySingleton() {
-        while (true) {
-            if (tryLock()) {
+    template <typename key_t, typename... rm_params>
+    LocalQueue<val_t>& getLocalQueue(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        auto& l_queues = localQueues();
+        auto it = l_queues.find(this);
+        if (it == l_queues.end()) {
+            auto free_node = [&recordMgr](qnode_t* node) { recordMgr.free_qnode(node); };
+            it = l_queues.emplace(std::piecewise_construct, std::forward_as_tuple(this), std::forward_as_tuple(free_node)).first;
+            m_tx->get_local_transaction().queues.push_back(this);
+        }
+        return it->second;
+    }
+
+    // dequeue and isEmpty keep the queue locked until the end of the transaction
+    template <typename key_t, typename... rm_params>
+    LocalQueue<val_t>& lockForTx(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        auto& local_transaction = m_tx->get_local_transaction();
+        auto& l_queue = getLocalQueue(recordMgr);
+        if (!l_queue.m_locked_by_me) {
+            if (!lockAndDrain(local_transaction.ownerId)) {
+                // queue is locked by another thread - abort
                 if (m_tx->DEBUG_MODE_QUEUE) {
-                    std::cout << "is empty singleton" << std::endl;
+                    std::cout << "Queue - couldn't lock" << std::endl;
                 }
-                auto ret = m_size;
-                setVersion(m_tx->getVersion());
-                setSingleton(true);
-                unlock();
-                return (ret <= 0);
+                m_tx->abort(AbortSite::QUEUE_LOCK, AbortReason::LOCKED);
             }
+            l_queue.m_locked_by_me = true;
         }
+        // validated after taking the lock, from here on only this transaction changes the version
+        validateTxSafe();
+        return l_queue;
     }
 
-    friend std::ostream& operator<< (std::ostream& stream, const Queue<val_t>& queue) {
-        //TODO: this
-        auto cur = queue.head;
-        while(!cur.is_null()) {
-            stream << "," << cur;
-            cur = cur->m_next;
+    // takes the lock, then waits for the singleton operations that started before it to finish
+    bool lockAndDrain(uint64_t owner) {
+        if (!tryLock(owner)) {
+            return false;
         }
-        return stream;
+        while (m_singletons != 0) {
+            __asm__ __volatile__("pause;");
+        }
+        return true;
     }
 
-    size_t hash() const {
-        auto hasher = std::hash<Queue<val_t>*>();
-        return hasher(&this);
+    bool tryEnterSingleton() {
+        m_singletons++;
+        if (!isLocked()) {
+            return true;
+        }
+        m_singletons--;
+        return false;
     }
 
-private:
+    void enterSingleton() {
+        while (!tryEnterSingleton()) {
+            while (isLocked()) {
+                __asm__ __volatile__("pause;");
+            }
+        }
+    }
+
+    template <typename key_t, typename... rm_params>
+    void exitSingleton(const RecordMgr<key_t, val_t, rm_params...>& recordMgr) {
+        // m_head is read before checking that we are alone: whoever unlinked the nodes before it is done,
+        // and whoever starts later can't reach them
+        qnode_t* upto = m_head;
+        if (m_singletons == 1) {
+            freeRetired(upto, [&recordMgr](qnode_t* node) { recordMgr.free_qnode(node); });
+        }
+        m_singletons--;
+    }
+
+    template <typename free_t>
+    void freeRetired(const free_t& free_node) {
+        freeRetired(m_head, free_node);
+    }
+
+    template <typename free_t>
+    void freeRetired(qnode_t* upto, const free_t& free_node) {
+        while (m_reclaim_from != upto) {
+            qnode_t* next = m_reclaim_from->m_next;
+            free_node(m_reclaim_from);
+            m_reclaim_from = next;
+        }
+    }
+
+    // a singleton change is marked like a singleton write to an LNode, the lock/owner bits are left alone
+    void markSingletonWrite() {
+        uint64_t version = m_tx->getVersion();
+        uint64_t l = m_version_mask;
+        while (true) {
+            uint64_t marked = (l & VERSIONNEG_MASK) | std::max(versionOf(l), version) | SINGLETON_MASK;
+            if (m_version_mask.compare_exchange_weak(l, marked)) {
+                return;
+            }
+        }
+    }
+
+    void validateTxSafe(uint64_t version_mask) {
+        auto& local_transaction = m_tx->get_local_transaction();
+        uint64_t version = versionOf(version_mask);
+        if (local_transaction.readVersion < version) {
+            // abort TX
+            m_tx->onNewerVersion(version);
+            m_tx->abort(AbortSite::QUEUE_VALIDATE, AbortReason::NEWER_VERSION);
+        }
+        if (local_transaction.readVersion == version && isSingletonMask(version_mask)) {
+            // TODO in the case of a thread running singleton and then TX
+            // this TX will abort once but for no reason
+            m_tx->incrementAndGetVersion();
+            m_tx->abort(AbortSite::QUEUE_VALIDATE, AbortReason::SINGLETON_CONFLICT);
+        }
+    }
+
+    void assertNotReadOnly() {
+        if (m_tx->get_local_transaction().readOnlyMode) {
+            throw std::logic_error("write operation in a transaction started with TXbeginReadOnly");
+        }
+    }
 };
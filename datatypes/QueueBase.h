@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * the part of a transactional Queue that TXend works with, independent of the value type.
+ * a queue adds itself to LocalTransaction::queues the first time a transaction touches it.
+ * the lock/version word has the layout of the LNode one.
+ */
+class QueueBase {
+public:
+    virtual ~QueueBase() = default;
+
+    // takes the queue lock for commit unless this transaction already holds it, false if someone else does
+    virtual bool lockForCommit(uint64_t owner) = 0;
+
+    // applies this thread's dequeues and enqueues, called with the lock held
+    virtual void commitLocal(uint64_t writeVersion) = 0;
+
+    // unlocks the queue if this transaction holds the lock and drops its local state, commit or abort
+    virtual void releaseLocal() = 0;
+
+    uint64_t getVersionMask() const {
+        return m_version_mask;
+    }
+
+    static uint64_t versionOf(uint64_t version_mask) {
+        return version_mask & (~VERSIONNEG_MASK);
+    }
+
+    static bool isSingletonMask(uint64_t version_mask) {
+        return (version_mask & SINGLETON_MASK) != 0;
+    }
+
+protected:
+    static constexpr uint64_t OWNER_SHIFT = 48;
+    static constexpr uint64_t OWNER_MASK = 0x0FFF000000000000L;
+    static constexpr uint64_t LOCK_MASK = 0x1000000000000000L;
+    static constexpr uint64_t SINGLETON_MASK = 0x4000000000000000L;
+    static constexpr uint64_t VERSIONNEG_MASK = LOCK_MASK | SINGLETON_MASK | OWNER_MASK;
+
+    QueueBase() : m_version_mask(0) {}
+
+    std::atomic<uint64_t> m_version_mask;
+};
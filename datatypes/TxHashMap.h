@@ -0,0 +1,431 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "LinkedList.h"
+
+/**
+ * an unordered transactional map: an array of LinkedList buckets that share one TX.
+ * a bucket op is a LinkedList op, so it is validated and committed by TXend like any other list op.
+ *
+ * resizing doesn't block: every bucket has a "moved" node, read (and logged) by every op on that bucket.
+ * the resizer moves one bucket at a time to the next table in a transaction that also deletes its moved node,
+ * so an op that used the old bucket concurrently aborts, and later ops follow the table chain.
+ * a resize that the inserts start is spread over the inserts that commit after it (RESIZE_STEP buckets each),
+ * no insert moves the whole table. once the last bucket moved the old table is retired: the ops hold the guard
+ * of the record manager until their transaction ends, so it's freed once every thread that held one then
+ * was seen without (see retireTable).
+ *
+ * outside of a transaction the ops run as single op transactions (a singleton op on a bucket could
+ * race with the move of that bucket and get lost), they retry until they commit.
+ */
+template <typename key_t, typename val_t, typename hash_t = std::hash<key_t>, typename Policy = DefaultTxPolicy>
+class TxHashMap {
+public:
+    using node_t = LNodeWrapper<key_t,val_t>;
+    using list_t = LinkedList<key_t, val_t, Policy>;
+    using tx_t = typename list_t::tx_t;
+    using record_mgr_t = typename list_t::record_mgr_t;
+
+    /**
+     * @param max_load_factor   grow (x2) when there are more keys than buckets * max_load_factor,
+     *                          0 keeps the number of buckets fixed. growing is checked on inserts that
+     *                          run outside of a transaction, and only they (and removes outside of one) count
+     *                          the keys, so a map filled by transactions grows with resize
+     */
+    TxHashMap(std::shared_ptr<tx_t> tx, const record_mgr_t& recordMgr, size_t n_buckets = 64,
+              size_t max_load_factor = 0) :
+        m_tx(std::move(tx)),
+        m_max_load_factor(max_load_factor),
+        m_size_estimate(0),
+        m_resizing(false),
+        m_resizes(0),
+        m_table(new Table(m_tx, recordMgr, n_buckets)),
+        m_n_buckets(n_buckets),
+        m_n_retired(0)
+    {}
+
+    TxHashMap(const TxHashMap&) = delete;
+
+    Optional<val_t> get(const key_t& key, const record_mgr_t& recordMgr) {
+        if (!m_tx->get_local_transaction().TX) {
+            return runAlone(true, [&] { return get(key, recordMgr); }, recordMgr);
+        }
+        return bucketFor(key, recordMgr)->get(key, recordMgr);
+    }
+
+    bool containsKey(const key_t& key, const record_mgr_t& recordMgr) {
+        return static_cast<bool>(get(key, recordMgr));
+    }
+
+    Optional<val_t> put(const key_t& key, const val_t& val, const record_mgr_t& recordMgr) {
+        if (!m_tx->get_local_transaction().TX) {
+            auto ret = runAlone(false, [&] { return put(key, val, recordMgr); }, recordMgr);
+            if (!ret) {
+                onInsertCommitted(recordMgr);
+            }
+            return ret;
+        }
+        return bucketFor(key, recordMgr)->put(key, val, recordMgr);
+    }
+
+    Optional<val_t> putIfAbsent(const key_t& key, const val_t& val, const record_mgr_t& recordMgr) {
+        if (!m_tx->get_local_transaction().TX) {
+            auto ret = runAlone(false, [&] { return putIfAbsent(key, val, recordMgr); }, recordMgr);
+            if (!ret) {
+                onInsertCommitted(recordMgr);
+            }
+            return ret;
+        }
+        return bucketFor(key, recordMgr)->putIfAbsent(key, val, recordMgr);
+    }
+
+    Optional<val_t> remove(const key_t& key, const record_mgr_t& recordMgr) {
+        if (!m_tx->get_local_transaction().TX) {
+            auto ret = runAlone(false, [&] { return remove(key, recordMgr); }, recordMgr);
+            if (m_max_load_factor && ret) {
+                m_size_estimate--;
+            }
+            return ret;
+        }
+        return bucketFor(key, recordMgr)->remove(key, recordMgr);
+    }
+
+    /**
+     * moves all the keys to a new table of n_buckets buckets, one bucket per transaction, and returns once
+     * the new table replaced the old one (inserts may move some of the buckets meanwhile).
+     * has to be called outside of a transaction, concurrent ops keep running (and may abort).
+     * @return false if another resize is running
+     */
+    bool resize(size_t n_buckets, const record_mgr_t& recordMgr) {
+        if (m_tx->get_local_transaction().TX) {
+            throw std::logic_error("TxHashMap::resize in a transaction");
+        }
+        if (!startResize(n_buckets, recordMgr)) {
+            return false;
+        }
+        uint64_t resizes = m_resizes; // no other resize ends before ours
+        moveBuckets(std::numeric_limits<size_t>::max(), recordMgr);
+        while (m_resizes == resizes) { // the buckets others took
+            std::this_thread::yield();
+        }
+        freeRetired(recordMgr);
+        return true;
+    }
+
+    size_t get_n_buckets() const {
+        return m_n_buckets;
+    }
+
+    // the tables a resize replaced that aren't freed yet, some thread held a guard since
+    size_t get_n_retired_tables() const {
+        return m_n_retired;
+    }
+
+    // the number of keys, not thread safe
+    uint64_t get_size() {
+        uint64_t res = 0;
+        Table* t = m_table;
+        for (auto& bucket : t->m_buckets) {
+            res += bucket->get_size();
+        }
+        return res;
+    }
+
+    void deinit_map(const record_mgr_t& recordMgr) {
+        for (auto& retired : m_retired) {
+            retired.table->deinit(recordMgr);
+            delete retired.table;
+        }
+        m_retired.clear();
+        m_n_retired = 0;
+        Table* t = m_table;
+        while (t) {
+            Table* next = t->m_next;
+            t->deinit(recordMgr);
+            delete t;
+            t = next;
+        }
+        m_table = nullptr;
+    }
+
+private:
+    class Table {
+    public:
+        std::vector<std::unique_ptr<list_t>> m_buckets;
+        std::vector<node_t> m_moved; // deleted once the bucket was moved to m_next
+        std::atomic<Table*> m_next;
+        std::atomic<size_t> m_taken; // the buckets of the resize to m_next that a thread took to move
+        std::atomic<size_t> m_left; // the buckets not moved yet, the table is retired when it drops to 0
+
+        Table(const std::shared_ptr<tx_t>& tx, const record_mgr_t& recordMgr, size_t n_buckets) :
+            m_next(nullptr),
+            m_taken(0),
+            m_left(n_buckets)
+        {
+            if (n_buckets == 0) {
+                throw std::invalid_argument("TxHashMap needs at least one bucket");
+            }
+            m_buckets.reserve(n_buckets);
+            m_moved.reserve(n_buckets);
+            for (size_t i = 0; i < n_buckets; i++) {
+                m_buckets.emplace_back(new list_t(tx, recordMgr));
+                m_moved.push_back(recordMgr.get_new_node(std::numeric_limits<key_t>::min(), val_t{}));
+            }
+        }
+
+        size_t size() const {
+            return m_buckets.size();
+        }
+
+        size_t indexOf(const key_t& key) const {
+            return hash_t{}(key) % m_buckets.size();
+        }
+
+        void deinit(const record_mgr_t& recordMgr) {
+            for (auto& bucket : m_buckets) {
+                bucket->deinit_list(recordMgr);
+            }
+            auto guard = recordMgr.getGuard();
+            for (auto& moved : m_moved) {
+                recordMgr.retire_node(moved);
+            }
+        }
+    };
+
+    // a table that a resize replaced, and the threads that held a guard then and weren't seen without one since
+    struct RetiredTable {
+        Table* table;
+        std::vector<int> busy;
+    };
+
+    // the buckets of a running resize an insert moves (and a resize starts after the size doubled),
+    // so the resize is done long before the next one
+    static constexpr size_t RESIZE_STEP = 2;
+
+    /**
+     * the transaction holds the guard of recordMgr from here until it ends (BasicTX::context), so the tables it
+     * reads aren't freed before (see retireTable). the fence orders the guard before the read of m_table
+     */
+    void enterTables(const record_mgr_t& recordMgr) {
+        if (!m_tx->template get_local_storge<key_t, val_t>().guardHeld) {
+            m_tx->context(recordMgr);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    // the bucket of key in the newest table the transaction may use, the moved nodes on the way are logged
+    list_t* bucketFor(const key_t& key, const record_mgr_t& recordMgr) {
+        enterTables(recordMgr);
+        Table* t = m_table;
+        while (true) {
+            size_t i = t->indexOf(key);
+            if (!isMoved(t, i)) {
+                return t->m_buckets[i].get();
+            }
+            t = t->m_next;
+        }
+    }
+
+    bool isMoved(Table* t, size_t i) {
+        node_t& moved = t->m_moved[i];
+        list_t* bucket = t->m_buckets[i].get();
+        auto& transaction = m_tx->get_local_transaction();
+        if (transaction.snapshot) {
+            // the table the bucket was in at the snapshot, its moved node is versioned like the list nodes
+            node_t next;
+            Optional<val_t> val;
+            return !bucket->readAt(moved, transaction.readVersion, next, val);
+        }
+        bucket->validateNode(moved);
+        bool ret = moved->isDeleted();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        bucket->validateNode(moved);
+        if (!transaction.readOnlyMode) {
+            m_tx->template get_local_storge<key_t, val_t>().readSet.push_back(moved);
+        }
+        return ret;
+    }
+
+    // the next table of the current one, false if a resize is running
+    bool startResize(size_t n_buckets, const record_mgr_t& recordMgr) {
+        bool expected = false;
+        if (!m_resizing.compare_exchange_strong(expected, true)) {
+            return false;
+        }
+        // only the end of this resize replaces m_table
+        m_table.load()->m_next = new Table(m_tx, recordMgr, n_buckets);
+        return true;
+    }
+
+    /**
+     * moves up to max_buckets buckets of the running resize, one transaction each. the thread that moves
+     * the last bucket makes the next table the current one and retires the old one.
+     * @return false once all the buckets were taken (or no resize is running)
+     */
+    bool moveBuckets(size_t max_buckets, const record_mgr_t& recordMgr) {
+        for (size_t n = 0; n < max_buckets; n++) {
+            Table* t;
+            size_t i;
+            {
+                // a table isn't retired before all its buckets moved, so it stays once we took one
+                auto guard = recordMgr.getGuard();
+                std::atomic_thread_fence(std::memory_order_seq_cst); // see enterTables
+                t = m_table;
+                if (!t->m_next) {
+                    return false;
+                }
+                i = t->m_taken++;
+                if (i >= t->size()) {
+                    return false;
+                }
+            }
+            std::vector<std::pair<key_t, val_t>> moving;
+            while (true) {
+                try {
+                    m_tx->TXbegin();
+                    moveBucket(t, i, moving, recordMgr);
+                    m_tx->TXend(recordMgr);
+                    break;
+                } catch (TxAbortException&) {
+                    m_tx->handle_abort(recordMgr);
+                }
+            }
+            if (--t->m_left == 0) {
+                Table* next = t->m_next;
+                m_table = next;
+                m_n_buckets = next->size();
+                m_resizes++;
+                m_resizing = false;
+                retireTable(t, recordMgr);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * t is no longer reachable from m_table. an op that read it holds a guard since before (enterTables, moveBuckets),
+     * so t is freed once every thread that holds a guard now was seen without one (freeRetired).
+     * with RECLAIM_NONE it's freed by deinit_map, like the records
+     */
+    void retireTable(Table* t, const record_mgr_t& recordMgr) {
+        std::atomic_thread_fence(std::memory_order_seq_cst); // m_table is written before the guards are read
+        RetiredTable retired{t, {}};
+        for (int tid = 0; tid < recordMgr.num_threads(); tid++) {
+            if (!recordMgr.is_quiescent(tid)) {
+                retired.busy.push_back(tid);
+            }
+        }
+        std::lock_guard<std::mutex> lock(m_retired_lock);
+        m_retired.push_back(std::move(retired));
+        m_n_retired = m_retired.size();
+    }
+
+    // frees the retired tables no thread can use any more, has to be called without a guard
+    void freeRetired(const record_mgr_t& recordMgr) {
+        if (!record_mgr_t::RECLAIMS || m_n_retired == 0) {
+            return;
+        }
+        std::vector<Table*> unused;
+        {
+            std::unique_lock<std::mutex> lock(m_retired_lock, std::try_to_lock);
+            if (!lock) {
+                return; // someone else checks them
+            }
+            size_t kept = 0;
+            for (size_t i = 0; i < m_retired.size(); i++) {
+                auto& busy = m_retired[i].busy;
+                busy.erase(std::remove_if(busy.begin(), busy.end(),
+                                          [&](int tid) { return recordMgr.is_quiescent(tid); }), busy.end());
+                if (busy.empty()) {
+                    unused.push_back(m_retired[i].table);
+                } else {
+                    if (kept != i) {
+                        m_retired[kept] = std::move(m_retired[i]);
+                    }
+                    kept++;
+                }
+            }
+            m_retired.resize(kept);
+            m_n_retired = kept;
+        }
+        for (Table* t : unused) {
+            t->deinit(recordMgr);
+            delete t;
+        }
+    }
+
+    // the body of one resize transaction: all of bucket i goes to the next table
+    void moveBucket(Table* t, size_t i, std::vector<std::pair<key_t, val_t>>& moving,
+                    const record_mgr_t& recordMgr) {
+        if (isMoved(t, i)) {
+            return;
+        }
+        list_t* bucket = t->m_buckets[i].get();
+        Table* next = t->m_next;
+        bucket->rangeQuery(std::numeric_limits<key_t>::min(), std::numeric_limits<key_t>::max(), moving, recordMgr);
+        for (auto& kv : moving) {
+            next->m_buckets[next->indexOf(kv.first)]->put(kv.first, kv.second, recordMgr);
+            bucket->remove(kv.first, recordMgr);
+        }
+        node_t& moved = t->m_moved[i];
+        m_tx->get_local_transaction().readOnly = false;
+        m_tx->template get_local_storge<key_t, val_t>().putIntoWriteSet(moved, moved->m_next, NULLOPT, true);
+    }
+
+    // runs op as a transaction of its own, until it commits
+    template <typename op_t>
+    Optional<val_t> runAlone(bool read_only, op_t op, const record_mgr_t& recordMgr) {
+        while (true) {
+            try {
+                if (read_only) {
+                    m_tx->TXbeginReadOnly();
+                } else {
+                    m_tx->TXbegin();
+                }
+                auto ret = op();
+                m_tx->TXend(recordMgr);
+                return ret;
+            } catch (TxAbortException&) {
+                m_tx->handle_abort(recordMgr);
+            }
+        }
+    }
+
+    // counted after the commit, an aborted attempt of the insert doesn't count.
+    // the insert moves RESIZE_STEP buckets of a running resize (or of the one it starts) and nothing more
+    void onInsertCommitted(const record_mgr_t& recordMgr) {
+        if (!m_max_load_factor) {
+            return;
+        }
+        m_size_estimate++;
+        size_t n_buckets = m_n_buckets;
+        if (!m_resizing && m_size_estimate > static_cast<long>(n_buckets * m_max_load_factor)) {
+            startResize(n_buckets * 2, recordMgr);
+        }
+        if (m_resizing) {
+            moveBuckets(RESIZE_STEP, recordMgr);
+        }
+        freeRetired(recordMgr);
+    }
+
+    std::shared_ptr<tx_t> m_tx;
+    const size_t m_max_load_factor;
+    std::atomic<long> m_size_estimate; // the committed inserts and removes of the ops outside of a transaction
+    std::atomic<bool> m_resizing;
+    std::atomic<uint64_t> m_resizes; // the finished resizes
+    std::atomic<Table*> m_table; // the next table of a running resize is its m_next
+    std::atomic<size_t> m_n_buckets; // of m_table
+    std::mutex m_retired_lock;
+    std::vector<RetiredTable> m_retired;
+    std::atomic<size_t> m_n_retired; // m_retired.size(), read without the lock
+};
@@ -1,15 +1,16 @@
 #pragma once
 
-template <typename key_t, typename val_t>
+template <typename key_t, typename val_t, typename record_mgr_t = RecordMgr<key_t, val_t>>
 class DummyIndex {
 public:
 
     using node_t = LNodeWrapper<key_t,val_t>;
-    DummyIndex(node_t head_node) : m_head(head_node) {}
+    DummyIndex(node_t head_node, const record_mgr_t& recordMgr) : m_head(head_node) {}
 
-    void add(node_t node_to_add) {}
-    void remove(node_t node) {}
-    node_t getPred(node_t node) { return m_head; }
+    void add(node_t node_to_add, const record_mgr_t& recordMgr) {}
+    void remove(node_t node, const record_mgr_t& recordMgr) {}
+    node_t getPred(const key_t& key, const record_mgr_t& recordMgr) { return m_head; }
+    void deinit(const record_mgr_t& recordMgr) {}
 
     node_t m_head;
 };
\ No newline at end of file
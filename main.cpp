@@ -7,11 +7,14 @@
 #include <ctime>
 #include <chrono>
 #include <list>
+#include <atomic>
 #include "algorithm"
 
 #include "nodes/LNode.h"
 #include "nodes/LNodeWrapper.h"
 #include "datatypes/LinkedList.h"
+#include "datatypes/Queue.h"
+#include "datatypes/TxHashMap.h"
 //#include "nodes/utils.h"
 //#include "nodes/Index.h"
 
@@ -20,6 +23,7 @@ enum TaskType
     INSERT,
     REMOVE,
     CONTAINS,
+    SCAN,
 };
 
 struct Task
@@ -30,7 +34,31 @@ struct Task
 };
 
 static int N_INIT_LIST;
+static const size_t SCAN_RANGE = 100; // a SCAN reads the keys [key, key + SCAN_RANGE]
 
+size_t scan(LinkedList<size_t, size_t>& LL, size_t key, std::vector<std::pair<size_t, size_t>>& out,
+            const RecordMgr<size_t, size_t>& recordMgr)
+{
+    return LL.rangeQuery(key, key + SCAN_RANGE, out, recordMgr);
+}
+
+// the hash map is unordered, a scan looks up every key of the range
+size_t scan(TxHashMap<size_t, size_t>& map, size_t key, std::vector<std::pair<size_t, size_t>>& out,
+            const RecordMgr<size_t, size_t>& recordMgr)
+{
+    size_t found = 0;
+    for (size_t k = key; k <= key + SCAN_RANGE; k++)
+    {
+        if (map.containsKey(k, recordMgr))
+        {
+            found++;
+        }
+    }
+    return found;
+}
+
+// runs tasks on a LinkedList or a TxHashMap
+template <typename map_t>
 class Worker
 {
 public:
@@ -38,11 +66,12 @@ public:
     Worker(const std::vector<Task>& _tasks,
            const int _tasks_index_begin,
            const int _tasks_index_end,
-           LinkedList<size_t, size_t>& _LL,
+           map_t& _LL,
            std::shared_ptr<TX> _tx,
            const int _ops_per_transc,
            std::shared_ptr<RecordMgr<size_t, size_t>::record_manager_t> global_recordMgr,
-           size_t tid
+           size_t tid,
+           const RetryPolicy* _retry_policy = nullptr
     ):
             tasks(_tasks),
             tasks_index_begin(_tasks_index_begin),
@@ -50,11 +79,18 @@ public:
             LL(_LL),
             tx(std::move(_tx)),
             ops_per_transc(_ops_per_transc),
-            recordMgr(global_recordMgr, tid)
+            recordMgr(global_recordMgr, tid),
+            retry_policy(_retry_policy)
     {}
 
     void work()
     {
+        if (retry_policy != nullptr)
+        {
+            work_with_retries();
+            write_set_stats = tx->get_local_storge<size_t, size_t>().writeSet.filterStats();
+            return;
+        }
         int ops_in_tx = 0;
         int inserts_occurred_in_tx = 0;
         int removes_occurred_in_tx = 0;
@@ -75,6 +111,7 @@ public:
                     inserts_occurred += inserts_occurred_in_tx;
                     removes_occurred += removes_occurred_in_tx;
                     succ_ops += ops_in_tx;
+                    commits++;
 
                     ops_in_tx = 0;
                     inserts_occurred_in_tx = 0;
@@ -91,6 +128,7 @@ public:
                 removes_occurred_in_tx = 0;
             }
         }
+        write_set_stats = tx->get_local_storge<size_t, size_t>().writeSet.filterStats();
     }
 
     int getSucc_ops() const { return succ_ops; }
@@ -101,19 +139,57 @@ public:
 
     int getRemoves_occurred() const { return removes_occurred; }
 
+    int getCommits() const { return commits; }
+
+    long getScanned_keys() const { return scanned_keys; }
+
+    const WriteSet<size_t, size_t>::FilterStats& getWrite_set_stats() const { return write_set_stats; }
+
 private:
     const std::vector<Task>& tasks;
     const int tasks_index_begin;
     const int tasks_index_end;
-    LinkedList<size_t, size_t>& LL;
+    map_t& LL;
     std::shared_ptr<TX> tx;
     const int ops_per_transc;
     RecordMgr<size_t, size_t> recordMgr;
+    const RetryPolicy* retry_policy; // null - an aborted transaction's tasks are dropped
 
     int succ_ops = 0;
     int fail_ops = 0;
     int inserts_occurred = 0;
     int removes_occurred = 0;
+    int commits = 0;
+    long scanned_keys = 0;
+    WriteSet<size_t, size_t>::FilterStats write_set_stats;
+    std::vector<std::pair<size_t, size_t>> scan_out;
+
+    // every transaction is retried (TX::run) until it commits, the failed attempts count as failed tasks
+    void work_with_retries()
+    {
+        for (int begin = tasks_index_begin; begin < tasks_index_end; begin += ops_per_transc)
+        {
+            int end = std::min(begin + ops_per_transc, tasks_index_end);
+            int inserts_occurred_in_tx = 0;
+            int removes_occurred_in_tx = 0;
+            long scanned_keys_before = scanned_keys;
+            tx->run([&] {
+                inserts_occurred_in_tx = 0;
+                removes_occurred_in_tx = 0;
+                scanned_keys = scanned_keys_before;
+                for (int index_task = begin; index_task < end; index_task++)
+                {
+                    commit_task_and_update_counters(index_task, inserts_occurred_in_tx, removes_occurred_in_tx);
+                }
+            }, *retry_policy, recordMgr);
+
+            inserts_occurred += inserts_occurred_in_tx;
+            removes_occurred += removes_occurred_in_tx;
+            succ_ops += end - begin;
+            fail_ops += (end - begin) * (tx->lastRunStats().attempts - 1);
+            commits++;
+        }
+    }
 
     void commit_task_and_update_counters(int index_task,
                                          int &inserts_occurred_in_transc,
@@ -137,6 +213,156 @@ private:
             case TaskType::CONTAINS:
                 LL.containsKey(task.key, recordMgr);
                 break;
+            case TaskType::SCAN:
+                scanned_keys += scan(LL, task.key, scan_out, recordMgr);
+                break;
+        }
+    }
+};
+
+// runs the same tasks on a queue: INSERT enqueues, REMOVE dequeues, CONTAINS asks isEmpty
+class QueueWorker
+{
+public:
+
+    QueueWorker(const std::vector<Task>& _tasks,
+                const int _tasks_index_begin,
+                const int _tasks_index_end,
+                Queue<size_t>& _queue,
+                std::shared_ptr<TX> _tx,
+                const int _ops_per_transc,
+                std::shared_ptr<RecordMgr<size_t, size_t>::record_manager_t> global_recordMgr,
+                size_t tid,
+                const RetryPolicy* _retry_policy = nullptr
+    ):
+            tasks(_tasks),
+            tasks_index_begin(_tasks_index_begin),
+            tasks_index_end(_tasks_index_end),
+            queue(_queue),
+            tx(std::move(_tx)),
+            ops_per_transc(_ops_per_transc),
+            recordMgr(global_recordMgr, tid),
+            retry_policy(_retry_policy)
+    {}
+
+    void work()
+    {
+        if (retry_policy != nullptr)
+        {
+            work_with_retries();
+            return;
+        }
+        int ops_in_tx = 0;
+        int enqueues_in_tx = 0;
+        int dequeues_in_tx = 0;
+
+        for (unsigned int index_task = tasks_index_begin; index_task < tasks_index_end; index_task++) {
+            try {
+                if (ops_in_tx == 0)
+                {
+                    tx->TXbegin();
+                }
+                ops_in_tx++;
+                commit_task_and_update_counters(index_task, enqueues_in_tx, dequeues_in_tx);
+
+                if (ops_in_tx == ops_per_transc || index_task == tasks_index_end - 1)
+                {
+                    tx->TXend<size_t, size_t>(recordMgr);
+
+                    enqueues += enqueues_in_tx;
+                    dequeues += dequeues_in_tx;
+                    succ_ops += ops_in_tx;
+                    commits++;
+
+                    ops_in_tx = 0;
+                    enqueues_in_tx = 0;
+                    dequeues_in_tx = 0;
+                }
+            }
+            catch(TxAbortException& e)
+            {
+                tx->handle_abort<size_t, size_t>(recordMgr);
+                fail_ops += ops_in_tx;
+
+                ops_in_tx = 0;
+                enqueues_in_tx = 0;
+                dequeues_in_tx = 0;
+            }
+        }
+    }
+
+    int getSucc_ops() const { return succ_ops; }
+
+    int getFail_ops() const { return fail_ops; }
+
+    int getEnqueues() const { return enqueues; }
+
+    int getDequeues() const { return dequeues; }
+
+    int getCommits() const { return commits; }
+
+private:
+    const std::vector<Task>& tasks;
+    const int tasks_index_begin;
+    const int tasks_index_end;
+    Queue<size_t>& queue;
+    std::shared_ptr<TX> tx;
+    const int ops_per_transc;
+    RecordMgr<size_t, size_t> recordMgr;
+    const RetryPolicy* retry_policy; // null - an aborted transaction's tasks are dropped
+
+    int succ_ops = 0;
+    int fail_ops = 0;
+    int enqueues = 0;
+    int dequeues = 0;
+    int commits = 0;
+
+    void work_with_retries()
+    {
+        for (int begin = tasks_index_begin; begin < tasks_index_end; begin += ops_per_transc)
+        {
+            int end = std::min(begin + ops_per_transc, tasks_index_end);
+            int enqueues_in_tx = 0;
+            int dequeues_in_tx = 0;
+            tx->run([&] {
+                enqueues_in_tx = 0;
+                dequeues_in_tx = 0;
+                for (int index_task = begin; index_task < end; index_task++)
+                {
+                    commit_task_and_update_counters(index_task, enqueues_in_tx, dequeues_in_tx);
+                }
+            }, *retry_policy, recordMgr);
+
+            enqueues += enqueues_in_tx;
+            dequeues += dequeues_in_tx;
+            succ_ops += end - begin;
+            fail_ops += (end - begin) * (tx->lastRunStats().attempts - 1);
+            commits++;
+        }
+    }
+
+    void commit_task_and_update_counters(int index_task,
+                                         int &enqueues_in_transc,
+                                         int &dequeues_in_transc)
+    {
+        Task task = tasks.at(index_task);
+        switch (task.task_type)
+        {
+            case TaskType::INSERT:
+                queue.enqueue(task.val, recordMgr);
+                enqueues_in_transc++;
+                break;
+            case TaskType::REMOVE:
+                try {
+                    queue.dequeue(recordMgr);
+                    dequeues_in_transc++;
+                } catch (EmptyQueueException& e) {
+                }
+                break;
+            case TaskType::CONTAINS:
+            case TaskType::SCAN:
+                queue.isEmpty(recordMgr);
+                break;
         }
     }
 };
@@ -157,11 +383,13 @@ Task get_random_task(TaskType task_op)
 void fill_tasks_vector(std::vector<Task>& tasks,
                        uint32_t n_tasks,
                        uint32_t x_of_100_inserts,
-                       uint32_t x_of_100_removes)
+                       uint32_t x_of_100_removes,
+                       uint32_t x_of_100_scans)
 {
     uint32_t n_inserts = n_tasks * x_of_100_inserts / 100;
     uint32_t n_removes = n_tasks * x_of_100_removes / 100;
-    uint32_t n_contains = n_tasks - (n_inserts + n_removes);
+    uint32_t n_scans = n_tasks * x_of_100_scans / 100;
+    uint32_t n_contains = n_tasks - (n_inserts + n_removes + n_scans);
 
     for (int i = 0; i < n_inserts; i++)
     {
@@ -171,6 +399,10 @@ void fill_tasks_vector(std::vector<Task>& tasks,
     {
         tasks.push_back(get_random_task(TaskType::REMOVE));
     }
+    for (int i = 0; i < n_scans; i++)
+    {
+        tasks.push_back(get_random_task(TaskType::SCAN));
+    }
     for (int i = 0; i < n_contains; i++)
     {
         tasks.push_back(get_random_task(TaskType::CONTAINS));
@@ -195,11 +427,15 @@ void print_tasks_vector(const std::vector<Task> tasks) //for debug
             case TaskType::CONTAINS:
                 std::cout << "CONTAINS " << task.key << " " << task.val << std::endl;
                 break;
+            case TaskType::SCAN:
+                std::cout << "SCAN " << task.key << " " << task.val << std::endl;
+                break;
         }
     }
 }
 
-int init_linked_list(LinkedList<size_t, size_t>& LL,
+template <typename map_t>
+int init_linked_list(map_t& LL,
                      std::shared_ptr<TX> tx,
                      const RecordMgr<size_t, size_t>& recordMgr)
 {
@@ -217,12 +453,15 @@ int init_linked_list(LinkedList<size_t, size_t>& LL,
     return init_LL_size;
 }
 
-void print_results(std::list<Worker>& workers, int linked_list_init_size,
+template <typename map_t>
+void print_results(std::list<Worker<map_t>>& workers, int linked_list_init_size,
                    std::chrono::duration<double>& running_time_sec, int actual_linked_list_size)
 {
     int expected_total_linked_list_size = linked_list_init_size;
     int total_ops_succeed = 0;
     int total_ops_failed = 0;
+    int total_commits = 0;
+    long total_scanned_keys = 0;
     size_t count = 0;
     for (const auto &worker : workers) {
         int inserts_occurred = worker.getInserts_occurred();
@@ -235,11 +474,17 @@ void print_results(std::list<Worker>& workers, int linked_list_init_size,
         std::cout << "removes occurred:" << removes_occurred << std::endl;
         std::cout << "succ ops:" << succ_ops << std::endl;
         std::cout << "fail ops:" << fail_ops << std::endl;
+        const auto& ws_stats = worker.getWrite_set_stats();
+        std::cout << "write set lookups:" << ws_stats.lookups
+                  << " filtered:" << ws_stats.filtered
+                  << " false positive rate:" << ws_stats.falsePositiveRate() << std::endl;
 
         expected_total_linked_list_size += inserts_occurred;
         expected_total_linked_list_size -= removes_occurred;
         total_ops_succeed += succ_ops;
         total_ops_failed += fail_ops;
+        total_commits += worker.getCommits();
+        total_scanned_keys += worker.getScanned_keys();
     }
 
     std::cout << "\nTotal: " << std::endl;
@@ -248,8 +493,110 @@ void print_results(std::list<Worker>& workers, int linked_list_init_size,
     std::cout << "expected linked list size: " << expected_total_linked_list_size << std::endl;
     std::cout << "actual linked list size: " << actual_linked_list_size << std::endl;
     std::cout << "total running time in secs: " << running_time_sec.count() << std::endl;
+    std::cout << "commit throughput (commits/sec): " << total_commits / running_time_sec.count() << std::endl;
+    std::cout << "op throughput (ops/sec): " << total_ops_succeed / running_time_sec.count() << std::endl;
+    std::cout << "scanned keys: " << total_scanned_keys << std::endl;
+}
+
+void print_queue_results(std::list<QueueWorker>& workers, int queue_init_size,
+                         std::chrono::duration<double>& running_time_sec, size_t actual_queue_size)
+{
+    int expected_queue_size = queue_init_size;
+    int total_ops_succeed = 0;
+    int total_ops_failed = 0;
+    int total_commits = 0;
+    for (const auto &worker : workers) {
+        expected_queue_size += worker.getEnqueues() - worker.getDequeues();
+        total_ops_succeed += worker.getSucc_ops();
+        total_ops_failed += worker.getFail_ops();
+        total_commits += worker.getCommits();
+    }
+
+    std::cout << "\nQueue: " << std::endl;
+    std::cout << "total ops succeed: " << total_ops_succeed << std::endl;
+    std::cout << "total ops failed: " << total_ops_failed << std::endl;
+    std::cout << "expected queue size: " << expected_queue_size << std::endl;
+    std::cout << "actual queue size: " << actual_queue_size << std::endl;
+    std::cout << "total running time in secs: " << running_time_sec.count() << std::endl;
+    std::cout << "commit throughput (commits/sec): " << total_commits / running_time_sec.count() << std::endl;
+    std::cout << "op throughput (ops/sec): " << total_ops_succeed / running_time_sec.count() << std::endl;
 }
 
+// polls the bytes of retired but not yet freed records while a run is going (keeps the peak),
+// and counts how many allocations of the run the record manager's pool served
+class MemorySampler
+{
+public:
+    using record_mgr_t = RecordMgr<size_t, size_t>;
+
+    explicit MemorySampler(std::shared_ptr<record_mgr_t::record_manager_t> global_recordMgr) :
+        global_recordMgr(std::move(global_recordMgr)), done(false), peak(0)
+    {
+        if (!record_mgr_t::STATS) {
+            return; // nothing to sample
+        }
+        pool_start = record_mgr_t::pool_stats(*this->global_recordMgr);
+        sampler = std::thread([this]() {
+            while (!done) {
+                peak = std::max(peak, record_mgr_t::unreclaimed_bytes(*this->global_recordMgr));
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+
+    void stop()
+    {
+        if (!record_mgr_t::STATS) {
+            return;
+        }
+        done = true;
+        sampler.join();
+        peak = std::max(peak, record_mgr_t::unreclaimed_bytes(*global_recordMgr));
+        pool = record_mgr_t::pool_stats(*global_recordMgr) - pool_start;
+    }
+
+    void print() const
+    {
+        if (!record_mgr_t::STATS) {
+            std::cout << "memory stats: build with RECORD_MGR_STATS" << std::endl;
+            return;
+        }
+        std::cout << "peak retired but unfreed bytes: " << peak << std::endl;
+        std::cout << "allocations: " << pool.requests << " pool hit rate: " << pool.hitRate() << std::endl;
+    }
+
+private:
+    std::shared_ptr<record_mgr_t::record_manager_t> global_recordMgr;
+    std::atomic<bool> done;
+    size_t peak;
+    record_mgr_t::PoolStats pool_start;
+    record_mgr_t::PoolStats pool;
+    std::thread sampler;
+};
+
+// the aborts (by site and reason, see AbortStats) and the irrevocable TX::run transactions of a run
+class AbortSampler
+{
+public:
+    explicit AbortSampler(const TX& tx) :
+        tx(tx), start(AbortStats::snapshot()), irrevocable_start(tx.getIrrevocableRuns())
+    {}
+
+    void print() const
+    {
+        if (AbortStats::ENABLED)
+        {
+            (AbortStats::snapshot() - start).print(std::cout);
+        }
+        std::cout << "irrevocable runs: " << tx.getIrrevocableRuns() - irrevocable_start << std::endl;
+    }
+
+private:
+    const TX& tx;
+    AbortBreakdown start;
+    uint64_t irrevocable_start;
+};
+
 int main(int argc, char *argv[]) {
     //parameters:
     uint32_t n_threads = std::atoi(argv[1]);
@@ -257,17 +604,31 @@ int main(int argc, char *argv[]) {
     uint32_t n_tasks_per_transaction = std::atoi(argv[3]);
     uint32_t x_of_100_inserts = std::atoi(argv[4]);
     uint32_t x_of_100_removes = std::atoi(argv[5]);
+    //optional: 0 - try each commit lock once (default), 1 - sorted lock acquisition with bounded spinning
+    auto lock_mode = (argc > 6 && std::atoi(argv[6]) == 1) ? TX::CommitLockMode::SORTED_SPIN : TX::CommitLockMode::TRY_ONCE;
+    //optional: x of 100 tasks are range scans of SCAN_RANGE keys (taken from the contains)
+    uint32_t x_of_100_scans = argc > 7 ? std::atoi(argv[7]) : 0;
+    //optional: 0 - drop the tasks of an aborted transaction (default), retry until commit (TX::run) with
+    //1 - exponential backoff, 2 - randomized backoff, 3 - karma
+    uint32_t retry_mode = argc > 8 ? std::atoi(argv[8]) : 0;
+    const RetryPolicy::Backoff backoffs[] = {RetryPolicy::Backoff::EXPONENTIAL, RetryPolicy::Backoff::RANDOMIZED,
+                                             RetryPolicy::Backoff::KARMA};
+    std::unique_ptr<RetryPolicy> retry_policy;
+    if (retry_mode >= 1 && retry_mode <= 3)
+    {
+        retry_policy = std::make_unique<RetryPolicy>(backoffs[retry_mode - 1]);
+    }
 
     auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(n_threads + 1);
 
     //create random tasks:
     N_INIT_LIST = n_tasks / 10;
     std::vector<Task> tasks;
-    fill_tasks_vector(tasks, n_tasks, x_of_100_inserts, x_of_100_removes);
+    fill_tasks_vector(tasks, n_tasks, x_of_100_inserts, x_of_100_removes, x_of_100_scans);
     //print_tasks_vector(tasks); //for debug
 
     //create linked list:
-    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    std::shared_ptr<TX> tx = std::make_shared<TX>(lock_mode);
     RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
     LinkedList<size_t, size_t> linked_list(tx, record_mgr);
 
@@ -276,17 +637,20 @@ int main(int argc, char *argv[]) {
     std::cout << "initial linked list size:" << init_LL_size << std::endl;
 
     //create workers:
-    std::list<Worker> workers;
+    std::list<Worker<LinkedList<size_t, size_t>>> workers;
 
     for (size_t i = 0; i < n_threads; i++)
     {
         int index_begin = i * n_tasks / n_threads;
         int index_end = (i + 1) * n_tasks / n_threads;
 
-        workers.emplace_back(tasks, index_begin, index_end, linked_list, tx, n_tasks_per_transaction, global_record_mgr, i + 1);
+        workers.emplace_back(tasks, index_begin, index_end, linked_list, tx, n_tasks_per_transaction, global_record_mgr, i + 1,
+                             retry_policy.get());
     }
 
     //measure time start:
+    MemorySampler list_sampler(global_record_mgr);
+    AbortSampler list_aborts(*tx);
     auto start_time = std::chrono::high_resolution_clock::now();
 
     //run workers:
@@ -302,10 +666,97 @@ int main(int argc, char *argv[]) {
 
     //measure time end:
     auto end_time = std::chrono::high_resolution_clock::now();
+    list_sampler.stop();
 
     //print results:
     std::chrono::duration<double> running_time_sec = end_time - start_time;
     print_results(workers, init_LL_size, running_time_sec, linked_list.get_size());
+    list_sampler.print();
+    list_aborts.print();
+    if (lock_mode == TX::CommitLockMode::SORTED_SPIN) {
+        std::cout << "aborts avoided by waiting for commit locks: " << tx->getAbortsAvoided() << std::endl;
+    }
+    std::cout << "snapshot extensions: " << tx->getExtensions() << ", failed: " << tx->getFailedExtensions()
+              << ", aborts avoided (extended commits): " << tx->getExtendedCommits() << std::endl;
     linked_list.deinit_list(record_mgr);
+    workers.clear(); //the next workers take over the record manager thread ids
+
+    //the same tasks on a hash map, about one key per bucket:
+    TxHashMap<size_t, size_t> hash_map(tx, record_mgr, N_INIT_LIST);
+    int init_map_size = init_linked_list(hash_map, tx, record_mgr);
+
+    std::list<Worker<TxHashMap<size_t, size_t>>> map_workers;
+    for (size_t i = 0; i < n_threads; i++)
+    {
+        int index_begin = i * n_tasks / n_threads;
+        int index_end = (i + 1) * n_tasks / n_threads;
+
+        map_workers.emplace_back(tasks, index_begin, index_end, hash_map, tx, n_tasks_per_transaction, global_record_mgr, i + 1,
+                                 retry_policy.get());
+    }
+
+    MemorySampler map_sampler(global_record_mgr);
+    AbortSampler map_aborts(*tx);
+    start_time = std::chrono::high_resolution_clock::now();
+    threads.clear();
+    for (auto& worker: map_workers)
+    {
+        threads.push_back(std::thread( [&]() { worker.work(); } ));
+    }
+    for (auto &thread: threads)
+    {
+        thread.join();
+    }
+    end_time = std::chrono::high_resolution_clock::now();
+    map_sampler.stop();
+
+    running_time_sec = end_time - start_time;
+    std::cout << "\nHash map (" << hash_map.get_n_buckets() << " buckets): " << std::endl;
+    print_results(map_workers, init_map_size, running_time_sec, hash_map.get_size());
+    map_sampler.print();
+    map_aborts.print();
+    hash_map.deinit_map(record_mgr);
+    map_workers.clear();
+
+    //the same tasks on a queue:
+    Queue<size_t> queue(tx, record_mgr);
+    int init_queue_size = 0;
+    tx->TXbegin();
+    for (; init_queue_size < N_INIT_LIST; init_queue_size++)
+    {
+        queue.enqueue(get_random_task(INSERT).val, record_mgr);
+    }
+    tx->TXend<size_t, size_t>(record_mgr);
+
+    std::list<QueueWorker> queue_workers;
+    for (size_t i = 0; i < n_threads; i++)
+    {
+        int index_begin = i * n_tasks / n_threads;
+        int index_end = (i + 1) * n_tasks / n_threads;
+
+        queue_workers.emplace_back(tasks, index_begin, index_end, queue, tx, n_tasks_per_transaction, global_record_mgr, i + 1,
+                                   retry_policy.get());
+    }
+
+    MemorySampler queue_sampler(global_record_mgr);
+    AbortSampler queue_aborts(*tx);
+    start_time = std::chrono::high_resolution_clock::now();
+    threads.clear();
+    for (auto& worker: queue_workers)
+    {
+        threads.push_back(std::thread( [&]() { worker.work(); } ));
+    }
+    for (auto &thread: threads)
+    {
+        thread.join();
+    }
+    end_time = std::chrono::high_resolution_clock::now();
+    queue_sampler.stop();
+
+    running_time_sec = end_time - start_time;
+    print_queue_results(queue_workers, init_queue_size, running_time_sec, queue.get_size());
+    queue_sampler.print();
+    queue_aborts.print();
+    queue.deinit_queue(record_mgr);
     return 0;
 }
\ No newline at end of file
@@ -1,14 +1,25 @@
 # pragma once
 
+#include <atomic>
 #include <climits>
 #include <mutex>
+#include <utility>
 #include <vector>
 
 #include "utils.h"
 #include "LNode.h"
 #include "LNodeWrapper.h"
-
-template <typename key_t, typename val_t>
+#include "IndexNode.h"
+#include "record_mgr.h"
+
+/**
+ * a skiplist index over the sorted linked list (after java's ConcurrentSkipListMap).
+ * index nodes live in the record manager and are linked with plain pointers, so the read side does no atomic RMW.
+ * every method has to be called under the guard (RecordMgr::getGuard) of the given RecordMgr,
+ * unlinked index nodes are retired to it.
+ * @tparam record_mgr_t  the record manager of the list (its policy's record_mgr, see TxPolicy.h)
+ */
+template <typename key_t, typename val_t, typename record_mgr_t = RecordMgr<key_t, val_t>>
 class Index {
 public:
     using node_t = LNodeWrapper<key_t,val_t>;
@@ -17,100 +28,69 @@ public:
      * Index initializer
      * @param head_node    assumed to be dummy node
      */
-    Index(node_t head_node) :
-        m_head_bottom(std::make_shared<HeadIndex>(head_node, std::shared_ptr<HeadIndex>(), std::shared_ptr<IndexNode>(), 0))
+    Index(node_t head_node, const record_mgr_t& recordMgr) :
+        m_head_top(nullptr),
+        m_head_bottom(recordMgr.get_new_head_index(head_node, nullptr, nullptr, 0))
     {
         m_head_top = m_head_bottom;
     }
 
-    ~Index() {
-        auto curr_head = m_head_top;
-        while (curr_head) {
-            curr_head->m_up = std::shared_ptr<HeadIndex>();
-            curr_head->m_right = std::shared_ptr<HeadIndex>();
-            curr_head = curr_head->m_down;
-        }
-    }
+    Index(const Index&) = delete;
 
-private:
-    class IndexNode {
-    public:
-        std::shared_ptr<IndexNode> m_right;
-        const std::shared_ptr<IndexNode> m_down;
-        const node_t m_node;
-
-        IndexNode(node_t node, std::shared_ptr<IndexNode> down, std::shared_ptr<IndexNode> right)
-                : m_node(node), m_down(down), m_right(right) { }
-
-        bool casRight(std::shared_ptr<IndexNode> cmp, std::shared_ptr<IndexNode> val) {
-            std::lock_guard<std::mutex> l(m_lock);
-            if (m_right == cmp) {
-                m_right = val;
-                return true;
-            } return false;
+    /**
+     * frees all the index nodes that are still linked and retires the list nodes it kept for snapshots,
+     * no one may use the index concurrently or after
+     */
+    void deinit(const record_mgr_t& recordMgr) {
+        head_index_t* head = m_head_top;
+        while (head) {
+            head_index_t* down = head->down();
+            freeLevel(head, recordMgr);
+            head = down;
         }
-
-        /**
-         * Tries to CAS newSucc as successor.  To minimize races with
-         * unlink that may lose this index node, if the node being
-         * indexed is known to be deleted, it doesn't try to link in.
-         *
-         * @param succ    the expected current successor
-         * @param new_succ the new successor
-         * @return true if successful
-         */
-        bool link(std::shared_ptr<IndexNode> succ, std::shared_ptr<IndexNode> new_succ) {
-            new_succ->m_right = succ;
-            if (m_node.is_deleted() || !m_node->m_val) {
-                // important so there won't be a race with anyone trying to unlink this
-                return false;
-            }
-            return casRight(succ, new_succ);
+        m_head_top = nullptr;
+        for (auto& node_and_version : m_unlinked) {
+            recordMgr.retire_node(std::move(node_and_version.first));
         }
+        m_unlinked.clear();
+    }
 
-        /**
-         * Tries to CAS right field to skip over apparent successor
-         * succ.  Fails (forcing a retraversal by caller) if this node
-         * is known to be deleted.
-         *
-         * @param succ the expected current successor
-         * @return true if successful
-         */
-        bool unlink(std::shared_ptr<IndexNode> succ) {
-            if (!succ)
-                return true;
-            if (m_node.is_deleted() || !m_node->m_val) {
-                // important so there won't be a race with anyone trying to unlink this
-                return false;
+    /**
+     * retires the list node that was unlinked at version once no snapshot can reach it any more
+     * (oldestSnapshot passed version, see LocalStorage::retireUnlinked), until then the index keeps it.
+     * the nodes kept before are checked again, the ones still kept at deinit are retired there.
+     * only multi version policies keep nodes, on their unlinks
+     */
+    void retireUnlinked(node_t node, uint64_t version, uint64_t oldestSnapshot, const record_mgr_t& recordMgr) {
+        std::lock_guard<std::mutex> lock(m_unlinked_lock);
+        m_unlinked.emplace_back(std::move(node), version);
+        size_t kept = 0;
+        for (size_t i = 0; i < m_unlinked.size(); i++) {
+            if (m_unlinked[i].second <= oldestSnapshot) {
+                recordMgr.retire_node(std::move(m_unlinked[i].first));
+            } else {
+                if (kept != i) {
+                    m_unlinked[kept] = std::move(m_unlinked[i]);
+                }
+                kept++;
             }
-            return casRight(succ, succ->m_right);
         }
+        m_unlinked.resize(kept);
+    }
 
-    private:
-        std::mutex m_lock;
-    };
-
-    class HeadIndex : public IndexNode {
-    public:
-        const uint64_t m_level;
-        const std::shared_ptr<HeadIndex> m_down;
-        std::shared_ptr<HeadIndex> m_up;
-        HeadIndex(node_t node, std::shared_ptr<HeadIndex> down, std::shared_ptr<IndexNode> right, uint64_t level):
-                IndexNode(node, down, right),
-                m_down(down),
-                m_up(std::shared_ptr<HeadIndex>()),
-                m_level(level) { }
-    };
+private:
+    using index_node_t = IndexNode<key_t, val_t>;
+    using head_index_t = HeadIndex<key_t, val_t>;
 
 public:
-    using index_node_vec = std::vector<std::shared_ptr<IndexNode>>;
+    using index_node_vec = std::vector<index_node_t*>;
 
-    friend std::ostream& operator<< (std::ostream& stream, const Index<key_t, val_t>& index) {
-        auto cur = index.m_head_top;
+    friend std::ostream& operator<< (std::ostream& stream, const Index& index) {
+        head_index_t* cur = index.m_head_top;
         while(cur) {
             auto level = cur->m_level;
             stream << "level: " << level;
-            std::shared_ptr<IndexNode> r = cur;
+            index_node_t* r = cur;
             while (r) {
                 stream << "\t" << r->m_node;
                 if (r->m_down)
@@ -118,18 +98,18 @@ public:
                 else
                     stream << "x";
                 stream << ",";
-                r = r->m_right;
+                r = r->right();
             }
             stream << "\tNone\n";
-            cur = cur->m_down;
+            cur = cur->down();
         }
         cur = index.m_head_bottom;
         stream << "bottom level: " << cur->m_level << " node: " << cur->m_node;
         return stream;
     }
 
-    bool insert_in_level(std::shared_ptr<IndexNode> new_node, std::shared_ptr<IndexNode> prev,
-            std::shared_ptr<IndexNode> next, std::shared_ptr<HeadIndex> head) {
+    bool insert_in_level(index_node_t* new_node, index_node_t* prev, index_node_t* next, head_index_t* head,
+            const record_mgr_t& recordMgr) {
         while (true) {
             bool finish;
             if (prev->link(next, new_node)) {
@@ -139,9 +119,11 @@ public:
                 return false;
             } // node is exactly being deleted, abort
             for (; ; ) { // continously try to insert in level
-                std::tie(finish, prev, next) = walkLevel(head, new_node->m_node->m_key);
+                std::tie(finish, prev, next) = walkLevel(head, new_node->m_node->m_key, recordMgr);
                 if (finish)
                     break;
+                if (head->isSealed()) // the level was removed, nothing can be linked into it
+                    return false;
             }
         }
     }
@@ -151,28 +133,33 @@ public:
      *
      * @param node_to_add    the node to be added
      */
-    void add(node_t node_to_add) {
+    void add(node_t node_to_add, const record_mgr_t& recordMgr) {
         // node_to_add is always safe to use because it is guarded by our caller
         if (node_to_add.is_null())
             throw std::invalid_argument("NULL pointer node was given to Index::add");
 
 
-        // find insertion points in the existing levels - from bottom up
-        auto head = m_head_bottom;
-        int insertion_level = 0;
+        // find insertion points in the existing levels - from bottom up.
+        // the heads of the levels are found from m_head_top down, a removed level is retired with its head
         index_node_vec prevs;
         index_node_vec nexts;
-        findInsertionPoints(node_to_add->m_key, prevs, nexts);
+        findInsertionPoints(node_to_add->m_key, prevs, nexts, recordMgr);
+        head_index_t* top = m_head_top;
+        std::vector<head_index_t*> heads(top->m_level + 1);
+        for (head_index_t* h = top; h; h = h->down()) {
+            heads[h->m_level] = h;
+        }
+        unsigned long insertion_level = 0;
         index_node_vec idxs;
         auto size = prevs.size();
-        auto level = createNewIndexNode(node_to_add, idxs, size);
-        while (head && head->m_level < level + 1 && head->m_level < size) {
-            auto curr_level = head->m_level;
-            if (!insert_in_level(idxs[curr_level], prevs[curr_level], nexts[curr_level], head)) {
+        auto level = createNewIndexNode(node_to_add, idxs, size, recordMgr);
+        while (insertion_level < heads.size() && insertion_level < level + 1 && insertion_level < size) {
+            if (!insert_in_level(idxs[insertion_level], prevs[insertion_level], nexts[insertion_level],
+                                 heads[insertion_level], recordMgr)) {
                 // the node is exactly being deleted
+                freeUnlinked(idxs, insertion_level, recordMgr);
                 return;
             }
-            head = head->m_up;
             insertion_level++;
         }
 
@@ -180,21 +167,24 @@ public:
             return;
         }
 
-        head = m_head_top;
+        head_index_t* head = m_head_top;
         auto old_level = head->m_level; // maybe in the meanwhile things have changed..
-        if (old_level > insertion_level) {
-            // there are layers we didn't get in. nevermind, abort
+        if (old_level + 1 != insertion_level || heads[old_level] != head) {
+            // there are layers we didn't get in (or the level below the new one isn't linked),
+            // or the top level was removed since and idxs[old_level] went with it. nevermind, abort
+            freeUnlinked(idxs, insertion_level, recordMgr);
             return;
         }
         if (old_level < level) {
             // try to grow - as before only by one level at a time!
-            node_t old_base = head->m_node;
-            auto newh = std::make_shared<HeadIndex>(old_base, head, idxs[old_level + 1], old_level + 1);
-            if (casHead(head, newh, true)) {
-                head = newh;
+            head_index_t* newh = recordMgr.get_new_head_index(head->m_node, head, idxs[old_level + 1], old_level + 1);
+            if (casHead(head, newh)) {
+                freeUnlinked(idxs, old_level + 2, recordMgr);
                 return;
             }
+            recordMgr.free_index_node(newh);
         } // else - maybe we lost some insertion level, not so bad..
+        freeUnlinked(idxs, insertion_level, recordMgr);
     }
 
     /**
@@ -203,19 +193,19 @@ public:
      *
      * @param node    the node to be removed
      */
-    void remove(node_t node) {
+    void remove(const node_t& node, const record_mgr_t& recordMgr) {
         if (node.is_null()) {
             throw std::invalid_argument("NULL pointer node was given to Index::remove");
         }
-        findPredecessor(node->m_key); // clean index
-        if (!m_head_top->m_right) {
-            tryReduceLevel();
+        findPredecessor(node->m_key, recordMgr); // clean index
+        if (!m_head_top.load()->right()) {
+            tryReduceLevel(recordMgr);
         }
     }
 
-    node_t getPred(const key_t& key) {
+    node_t getPred(const key_t& key, const record_mgr_t& recordMgr) {
         for (; ; ) {
-            node_t b = findPredecessor(key);
+            node_t b = findPredecessor(key, recordMgr);
             if (!b.is_deleted() && b->m_val) { // not deleted
                 return b;
             }
@@ -223,37 +213,11 @@ public:
     }
 
 private:
-    std::mutex m_lock;
-
     /**
      * compareAndSet head node
      */
-    bool casHead(std::shared_ptr<HeadIndex> cmp, std::shared_ptr<HeadIndex> val, bool up) {
-        std::lock_guard<std::mutex> l(m_lock);
-        if (m_head_top == cmp) {
-            if (up) levelUp(cmp, val);
-            else levelDown(cmp, val);
-            return true;
-        } return false;
-    }
-
-    /**
-     * level up m_top_head to val, make old head points to the new one as well
-     * m_lock is assumed to be taken,
-     */
-    bool levelUp(std::shared_ptr<HeadIndex> cmp, std::shared_ptr<HeadIndex> val) {
-        assert(val->m_down == cmp && !val->m_up);
-        cmp->m_up = val;
-        m_head_top = val;
-    }
-
-    /**
-     * level down m_top_head to val
-     * m_lock is assumed to be taken,
-     */
-    bool levelDown(std::shared_ptr<HeadIndex> cmp, std::shared_ptr<HeadIndex> val) {
-        val->m_up = std::shared_ptr<HeadIndex>();
-        m_head_top = val;
+    bool casHead(head_index_t* cmp, head_index_t* val) {
+        return m_head_top.compare_exchange_strong(cmp, val);
     }
 
     /**
@@ -264,10 +228,11 @@ private:
      *
      * @return a predecessor of key
      */
-    node_t findPredecessor(const key_t& key_to_find) {
-        index_node_vec prevs;
-        index_node_vec nexts;
-        findInsertionPoints(key_to_find, prevs, nexts);
+    node_t findPredecessor(const key_t& key_to_find, const record_mgr_t& recordMgr) {
+        // reused between calls, this is the hot path of every list operation
+        static thread_local index_node_vec prevs;
+        static thread_local index_node_vec nexts;
+        findInsertionPoints(key_to_find, prevs, nexts, recordMgr);
         assert(prevs.size() >= 1 && "findPredecessor: findInsertionPoints didn't init prevs?!" );
         return prevs[0]->m_node;
     }
@@ -292,51 +257,85 @@ private:
      * slowing down access more than would an occasional unwanted
      * reduction.
      */
-    void tryReduceLevel() {
-        auto h = m_head_top;
+    void tryReduceLevel(const record_mgr_t& recordMgr) {
+        head_index_t* h = m_head_top;
         if (h->m_level < 3) {
             return;
         }
-        auto d = h->m_down;
-        auto e = d->m_down;
+        head_index_t* d = h->down();
+        head_index_t* e = d->down();
         if (
                 d && e &&
-                !e->m_right &&
-                !d->m_right &&
-                !h->m_right &&
-                casHead(h, d, false) && // try to set
-                h->m_right
-            ) { // recheck
-            casHead(d, h, true);   // try to backout
+                !e->right() &&
+                !d->right() &&
+                !h->right() &&
+                casHead(h, d) // try to set
+            ) {
+            if (h->right() && casHead(d, h)) { // recheck
+                return; // backed out
+            }
+            retireLevel(h, recordMgr);
+        }
+    }
+
+    /**
+     * retires a level tryReduceLevel removed, with the index nodes adders linked into it in the meanwhile.
+     * every node is sealed before its successor is read, so nothing can be linked into the level
+     * or unlinked from it any more (by anyone who'd retire the node as well)
+     */
+    void retireLevel(head_index_t* head, const record_mgr_t& recordMgr) {
+        head->seal();
+        index_node_t* r = head->right();
+        while (r) {
+            r->seal();
+            index_node_t* next = r->right();
+            recordMgr.retire_index_node(r);
+            r = next;
+        }
+        recordMgr.retire_index_node(head);
+    }
+
+    /**
+     * frees a level, its head and the index nodes linked into it
+     */
+    void freeLevel(head_index_t* head, const record_mgr_t& recordMgr) {
+        index_node_t* r = head->right();
+        while (r) {
+            index_node_t* next = r->right();
+            recordMgr.free_index_node(r);
+            r = next;
         }
+        recordMgr.free_index_node(head);
     }
 
     /**
-     * walk on one level, starts with start, until the predecessor (smaller or equal) of node
+     * walk on one level, starts with start, until the predecessor (smaller or equal) of node.
+     * index nodes of deleted nodes are unlinked and retired on the way
      *
      * @param start the node to start the search from
      * @param node_to_add node to search - notice! it will never be deleted during our ops, because it is guarded by the caller
      * @return a tuple: is the search was finished (or needs to restart), predecessor, predecessor's right
      * */
-    std::tuple<bool, std::shared_ptr<IndexNode>, std::shared_ptr<IndexNode>> walkLevel
-            (std::shared_ptr<IndexNode> start, const key_t& key_to_add) {
+    std::tuple<bool, index_node_t*, index_node_t*> walkLevel
+            (index_node_t* start, const key_t& key_to_add, const record_mgr_t& recordMgr) {
         if (!start)
             throw std::invalid_argument("NULL pointer head was given to Index::walkOnLevel");
-        auto q = start;
-        auto r = q->m_right;
+        index_node_t* q = start;
+        index_node_t* r = q->right();
         while (r) {
-            node_t n = r->m_node;
+            const node_t& n = r->m_node; // no copy, r is kept alive by the guard
             // compare before deletion check avoids needing recheck
             bool c = (key_to_add > n->m_key);
             if (n.is_deleted() || !n->m_val) { // need to unlink deleted node
                 if (!q->unlink(r)) { // need to restart walk..
-                    return std::make_tuple(false, std::shared_ptr<IndexNode>(), std::shared_ptr<IndexNode>());
+                    return std::make_tuple(false, nullptr, nullptr);
                 }
+                recordMgr.retire_index_node(r);
             } else if (c) {
                 q = r;
             } else break;
 
-            r = q->m_right;
+            r = q->right();
         }
         return std::make_tuple(true, q, r);
     }
@@ -346,33 +345,44 @@ private:
      * (level is randomly generated)
      * @param max_level - maximum level to grow to
      * */
-    long unsigned int createNewIndexNode(node_t node_to_add, index_node_vec& idxs, long unsigned int max_level) {
+    long unsigned int createNewIndexNode(const node_t& node_to_add, index_node_vec& idxs, long unsigned int max_level,
+            const record_mgr_t& recordMgr) {
         int rnd = get_random_in_range(2, (1 << 30) - 1);
         long unsigned int level = 0;
         while (((rnd >>= 1) & 1) != 0)
             ++level;
         level = std::min(level, max_level + 1); // always try to grow by at most one level
-        std::shared_ptr<IndexNode> idx = NULL;
+        index_node_t* idx = nullptr;
 
         // create the new nodes
         for (int i = 0; i < level + 1; ++i) {
-            idx = std::make_shared<IndexNode>(node_to_add, idx, std::shared_ptr<IndexNode>());
+            idx = recordMgr.get_new_index_node(node_to_add, idx, nullptr);
             idxs.push_back(idx);
         }
         return level;
     }
 
-    bool findInsertionPoints(const key_t& key_to_find, index_node_vec& prevs, index_node_vec& nexts){
+    /**
+     * frees idxs[from..], the index nodes add() didn't link. no one could have seen them
+     */
+    void freeUnlinked(const index_node_vec& idxs, unsigned long from, const record_mgr_t& recordMgr) {
+        for (auto i = from; i < idxs.size(); ++i) {
+            recordMgr.free_index_node(idxs[i]);
+        }
+    }
+
+    bool findInsertionPoints(const key_t& key_to_find, index_node_vec& prevs, index_node_vec& nexts,
+            const record_mgr_t& recordMgr) {
         while (true) {
             prevs.clear();
             nexts.clear();
             bool finish;
-            auto level_head = m_head_top;
-            std::shared_ptr<IndexNode> curr = level_head;
+            head_index_t* level_head = m_head_top;
+            index_node_t* curr = level_head;
             int64_t level = level_head->m_level;
-            auto d = curr->m_down;
-            std::shared_ptr<IndexNode> prev;
-            std::shared_ptr<IndexNode> next;
+            index_node_t* d;
+            index_node_t* prev;
+            index_node_t* next;
 
             prevs.resize(level + 1);
             nexts.resize(level + 1);
@@ -381,10 +391,12 @@ private:
                     break;
                 }
                 for (;;) {
-                    std::tie(finish, prev, next) = walkLevel(curr, key_to_find);
-                    if (finish) break;
+                    std::tie(finish, prev, next) = walkLevel(curr, key_to_find, recordMgr);
+                    if (finish || level_head->isSealed()) break;
                     curr = level_head;
                 }
+                if (!finish) // the level was removed (tryReduceLevel), start the whole operation over
+                    break;
                 if (prev->m_node.is_deleted() || !prev->m_node->m_val) // node prev is about to be removed, restart level
                     continue;
                 prevs[level] = prev;
@@ -395,11 +407,13 @@ private:
                 }
                 curr = d;
                 level--;
-                level_head = level_head->m_down;
+                level_head = level_head->down();
             }
         }
     }
 
-    std::shared_ptr<HeadIndex> m_head_top;
-    const std::shared_ptr<HeadIndex> m_head_bottom;
+    std::atomic<head_index_t*> m_head_top;
+    head_index_t* const m_head_bottom;
+    std::mutex m_unlinked_lock;
+    std::vector<std::pair<node_t, uint64_t>> m_unlinked; // unlinked list nodes a snapshot may still reach
 };
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "LNodeWrapper.h"
+
+/**
+ * a node in one level of the index (see Index.h), it points to the list node it indexes.
+ * index nodes are allocated and retired through RecordMgr and linked with plain pointers,
+ * so walking the index takes no reference counts. they are only valid under RecordMgr::getGuard()
+ */
+template <typename key_t, typename val_t>
+class IndexNode {
+public:
+    using node_t = LNodeWrapper<key_t,val_t>;
+
+    node_t m_node;
+    IndexNode* m_down;
+    std::atomic<IndexNode*> m_right;
+
+    //for debra we need the node to be defult ctr
+    IndexNode() : m_node(), m_down(nullptr), m_right(nullptr) { }
+
+    void init(node_t node, IndexNode* down, IndexNode* right) {
+        m_node = std::move(node);
+        m_down = down;
+        m_right = right;
+    }
+
+    // the successor, without the removal mark
+    IndexNode* right() const {
+        return unmarked(m_right.load());
+    }
+
+    bool casRight(IndexNode* cmp, IndexNode* val) {
+        return m_right.compare_exchange_strong(cmp, val);
+    }
+
+    /**
+     * Tries to CAS newSucc as successor.  To minimize races with
+     * unlink that may lose this index node, if the node being
+     * indexed is known to be deleted, it doesn't try to link in.
+     *
+     * @param succ    the expected current successor
+     * @param new_succ the new successor
+     * @return true if successful
+     */
+    bool link(IndexNode* succ, IndexNode* new_succ) {
+        new_succ->m_right = succ;
+        if (m_node.is_deleted() || !m_node->m_val) {
+            // important so there won't be a race with anyone trying to unlink this
+            return false;
+        }
+        return casRight(succ, new_succ); // fails if this node was marked
+    }
+
+    /**
+     * Tries to CAS right field to skip over apparent successor
+     * succ.  Fails (forcing a retraversal by caller) if this node
+     * is known to be deleted.
+     * succ is marked first (as in harris' list), so that only one thread ever unlinks it
+     * and no node can be linked after it - the caller that gets true owns succ and retires it.
+     *
+     * @param succ the expected current successor
+     * @return true if successful
+     */
+    bool unlink(IndexNode* succ) {
+        if (!succ)
+            return true;
+        if (m_node.is_deleted() || !m_node->m_val) {
+            // important so there won't be a race with anyone trying to unlink this
+            return false;
+        }
+        succ->mark();
+        return casRight(succ, succ->right());
+    }
+
+    /**
+     * marks the successor as unlink marks the node it removes, so nothing can be linked after
+     * this node or unlinked from after it any more (a level that was removed from the index is sealed this way)
+     */
+    void seal() {
+        mark();
+    }
+
+    bool isSealed() const {
+        return is_marked(m_right.load());
+    }
+
+private:
+    static constexpr uintptr_t MARK = 1;
+
+    static IndexNode* unmarked(IndexNode* p) {
+        return reinterpret_cast<IndexNode*>(reinterpret_cast<uintptr_t>(p) & ~MARK);
+    }
+
+    static bool is_marked(IndexNode* p) {
+        return (reinterpret_cast<uintptr_t>(p) & MARK) != 0;
+    }
+
+    void mark() {
+        IndexNode* succ = m_right;
+        while (!is_marked(succ) && !casRight(succ, reinterpret_cast<IndexNode*>(reinterpret_cast<uintptr_t>(succ) | MARK))) {
+            succ = m_right;
+        }
+    }
+};
+
+/**
+ * the first node of a level, the levels are linked down through their heads from Index::m_head_top
+ */
+template <typename key_t, typename val_t>
+class HeadIndex : public IndexNode<key_t, val_t> {
+public:
+    using node_t = LNodeWrapper<key_t,val_t>;
+
+    uint64_t m_level;
+
+    //for debra we need the node to be defult ctr
+    HeadIndex() : m_level(0) { }
+
+    void init(node_t node, HeadIndex* down, IndexNode<key_t, val_t>* right, uint64_t level) {
+        IndexNode<key_t, val_t>::init(std::move(node), down, right);
+        m_level = level;
+    }
+
+    HeadIndex* down() const {
+        return static_cast<HeadIndex*>(this->m_down);
+    }
+};
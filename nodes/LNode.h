@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <atomic>
 #include <memory>
@@ -9,8 +10,13 @@
 template <typename key_t, typename val_t>
 class LNodeWrapper;
 
+static constexpr size_t CACHE_LINE_SIZE = 64;
+
 /**
  * the basic node of the sorted linked list
+ * the fields a traversal reads (version word, key, next) come first. with LNODE_COMPACT the node is
+ * cache line aligned, so they share one line, and the value stays on that line when it fits
+ * (otherwise it starts on the next line, which only lookups that found their key touch)
  * @tparam node_t the way we hold pointers for this list
  */
 template <typename key_t, typename val_t>
@@ -18,28 +24,54 @@ class LNode {
 public:
     using node_t = LNodeWrapper<key_t,val_t>;
 
+#if defined(LNODE_COMPACT)
+    static constexpr bool COMPACT = true;
+#else
+    static constexpr bool COMPACT = false;
+#endif
+    static constexpr size_t HOT_SIZE = sizeof(uint64_t) + sizeof(key_t) + sizeof(node_t);
+    static constexpr bool INLINE_VAL = !COMPACT || HOT_SIZE + sizeof(Optional<val_t>) <= CACHE_LINE_SIZE;
+
+private:
+    alignas(COMPACT ? CACHE_LINE_SIZE : alignof(std::atomic<uint64_t>)) std::atomic<uint64_t> m_version_mask;
+
+public:
     key_t m_key;
-    Optional<val_t> m_val;
     node_t m_next;
+    alignas(INLINE_VAL ? alignof(Optional<val_t>) : CACHE_LINE_SIZE) Optional<val_t> m_val;
 
     //for debra we need the node to be defult ctr
-    LNode() : m_key(key_t{}), m_version_mask(0) { }
+    LNode() : m_version_mask(0), m_key(key_t{}) { }
 
-    explicit LNode(key_t key) : m_key(std::move(key)), m_version_mask(0) {}
+    explicit LNode(key_t key) : m_version_mask(0), m_key(std::move(key)) {}
 
-    bool tryLock() {
+    // the record manager's pool hands out reclaimed nodes without constructing them again
+    void reset(key_t key) {
+        m_version_mask = 0;
+        m_key = std::move(key);
+        m_next = node_t();
+        m_val = NULLOPT;
+    }
+
+    /**
+     * @param owner the id of the locking thread (LocalTransaction::ownerId), it is kept in the
+     *              lock bits so a committing transaction can tell its own locks apart.
+     *              singleton operations lock with owner 0
+     */
+    bool tryLock(uint64_t owner = 0) {
         uint64_t l = m_version_mask;
         if ((l & LOCK_MASK) != 0) {
             return false;
         }
-        uint64_t locked = l | LOCK_MASK;
+        assert (owner <= MAX_OWNER && "lock owner id doesn't fit in the node word");
+        uint64_t locked = l | LOCK_MASK | (owner << OWNER_SHIFT);
         return m_version_mask.compare_exchange_strong(l, locked);
     }
 
     void unlock() {
         uint64_t l = m_version_mask;
         assert ((l & LOCK_MASK) != 0 && "unlocking a node that is not locked");
-        uint64_t  unlocked = l & (~LOCK_MASK);
+        uint64_t  unlocked = l & (~(LOCK_MASK | OWNER_MASK));
         bool ret = m_version_mask.compare_exchange_strong(l, unlocked);
         assert (ret && "compare_exchange_strong in unlock failed");
     }
@@ -49,6 +81,31 @@ public:
         return (l & LOCK_MASK) != 0;
     }
 
+    // the whole lock/flags/version word, so several of them can be checked with a single load
+    uint64_t getVersionMask() {
+        return m_version_mask;
+    }
+
+    static bool isLockedByOther(uint64_t version_mask, uint64_t owner) {
+        return (version_mask & LOCK_MASK) != 0 && ((version_mask & OWNER_MASK) >> OWNER_SHIFT) != owner;
+    }
+
+    static uint64_t versionOf(uint64_t version_mask) {
+        return version_mask & (~VERSIONNEG_MASK);
+    }
+
+    static bool isSingletonMask(uint64_t version_mask) {
+        return (version_mask & SINGLETON_MASK) != 0;
+    }
+
+    static bool isLockedMask(uint64_t version_mask) {
+        return (version_mask & LOCK_MASK) != 0;
+    }
+
+    static bool isDeletedMask(uint64_t version_mask) {
+        return (version_mask & DELETE_MASK) != 0;
+    }
+
     bool isDeleted() {
         uint64_t l = m_version_mask;
         return (l & DELETE_MASK) != 0;
@@ -164,12 +221,16 @@ public:
         }
         m_version_mask = l;
     }
+    // lock owner ids are 12 bits, 0 is reserved for singleton operations
+    static constexpr uint64_t MAX_OWNER = 0xFFF;
+
 private:
 
     static constexpr uint64_t LOCK_MASK = 0x1000000000000000L;
     static constexpr uint64_t DELETE_MASK = 0x2000000000000000L;
     static constexpr uint64_t SINGLETON_MASK = 0x4000000000000000L;
-    static constexpr uint64_t VERSIONNEG_MASK = LOCK_MASK | DELETE_MASK | SINGLETON_MASK;
-    std::atomic<uint64_t> m_version_mask;
+    static constexpr uint64_t OWNER_SHIFT = 48;
+    static constexpr uint64_t OWNER_MASK = MAX_OWNER << OWNER_SHIFT;
+    static constexpr uint64_t VERSIONNEG_MASK = LOCK_MASK | DELETE_MASK | SINGLETON_MASK | OWNER_MASK;
 };
 
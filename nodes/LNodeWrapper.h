@@ -1,29 +1,31 @@
 #pragma once
 
 #include <memory>
+#include <functional>
 #include "LNode.h"
 
 #if defined(UNSAFE)
 
 /**
  * this class is wrapping the Lnode so we would have easier control on its memory model.
- * this one is an unsafe memory wrapper
+ * this one is an unsafe memory wrapper: a plain pointer, nodes are never freed
  */
 template <typename key_t, typename val_t>
 class LNodeWrapper {
 public:
-    LNodeWrapper() : m_node(NULL), deleted(std::make_shared<bool>(false)) {}
+    LNodeWrapper() : m_node(NULL) {}
 
     explicit LNodeWrapper(key_t key) {
         m_node = new LNode<key_t, val_t>(key);
-        deleted = std::make_shared<bool>(false);
     }
 
     LNodeWrapper(key_t key, val_t val) : LNodeWrapper(std::move(key)){
         m_node->m_val = std::move(val);
-        deleted = std::make_shared<bool>(false);
     }
 
+    // a node of the record manager, which may be a subclass of LNode (RecordMgr::node_t)
+    explicit LNodeWrapper(LNode<key_t, val_t>* node) : m_node(node) {}
+
     bool operator==(const LNodeWrapper<key_t, val_t>& other) const {
         return m_node == other.m_node;
     }
@@ -32,20 +34,25 @@ public:
         return m_node != other.m_node;
     }
 
-    bool is_null() {
+    // orders nodes by address, used for deadlock free lock acquisition
+    bool operator<(const LNodeWrapper<key_t, val_t>& other) const {
+        return std::less<const LNode<key_t, val_t>*>()(operator->(), other.operator->());
+    }
+
+    bool is_null() const {
         return m_node == NULL;
     }
 
-    bool is_not_null() {
+    bool is_not_null() const {
         return m_node != NULL;
     }
 
+    // the node was removed from the list (its DELETE bit)
     bool is_deleted() const {
-        return *deleted;
+        return m_node->isDeleted();
     }
 
     void delete_wrapped_node() {
-        *deleted = false;
     }
 
     LNode<key_t, val_t>* operator->() {
@@ -79,7 +86,6 @@ public:
 
 private:
     LNode<key_t, val_t>* m_node;
-    std::shared_ptr<bool> deleted;
 };
 
 namespace std {
@@ -99,16 +105,14 @@ namespace std {
 
 /**
  * this class is wrapping the Lnode so we would have easier control on its memory model.
- * this one is an unsafe memory wrapper
+ * this one is a plain pointer to a node of the record manager
  */
 template <typename key_t, typename val_t>
 class LNodeWrapper {
 public:
-    LNodeWrapper() : m_node(NULL) , deleted(std::make_shared<bool>(false)) {}
+    LNodeWrapper() : m_node(NULL) {}
 
-    LNodeWrapper(LNode<key_t, val_t>* node) : m_node(node) , deleted(std::make_shared<bool>(false)) {}
-
-    LNodeWrapper(const LNodeWrapper<key_t, val_t>& other) : m_node(other.m_node) , deleted(std::make_shared<bool>(false)) {}
+    LNodeWrapper(LNode<key_t, val_t>* node) : m_node(node) {}
 
     bool operator==(const LNodeWrapper<key_t, val_t>& other) const {
         return m_node == other.m_node;
@@ -118,21 +122,26 @@ public:
         return m_node != other.m_node;
     }
 
-    bool is_null() {
+    // orders nodes by address, used for deadlock free lock acquisition
+    bool operator<(const LNodeWrapper<key_t, val_t>& other) const {
+        return std::less<const LNode<key_t, val_t>*>()(operator->(), other.operator->());
+    }
+
+    bool is_null() const {
         return m_node == NULL;
     }
 
-    bool is_not_null() {
+    bool is_not_null() const {
         return m_node != NULL;
     }
 
+    // the node was removed from the list (its DELETE bit)
     bool is_deleted() const {
-        return *deleted;
+        return m_node->isDeleted();
     }
 
-    //return the wrapped node and this wrapper is considered deleted
+    // the wrapped node, for the record manager to retire
     LNode<key_t, val_t>* delete_wrapped_node() {
-//        *deleted = true;
         return m_node;
     }
 
@@ -167,7 +176,6 @@ public:
 
 private:
     LNode<key_t, val_t>* m_node;
-    std::shared_ptr<bool> deleted;
 };
 
 namespace std {
@@ -193,19 +201,19 @@ namespace std {
 template <typename key_t, typename val_t>
 class LNodeWrapper {
 public:
-    LNodeWrapper() {
-        deleted = std::make_shared<bool>(false);
-    };
+    LNodeWrapper() {}
 
     explicit LNodeWrapper(key_t key) {
         m_node = std::make_shared<LNode<key_t, val_t>>(std::move(key));
-        deleted = std::make_shared<bool>(false);
     }
 
     LNodeWrapper(key_t key, val_t val) : LNodeWrapper(std::move(key)){
         m_node->m_val = std::move(val);
     }
 
+    // a node of the record manager, which may be a subclass of LNode (RecordMgr::node_t)
+    explicit LNodeWrapper(std::shared_ptr<LNode<key_t, val_t>> node) : m_node(std::move(node)) {}
+
     bool operator==(const LNodeWrapper<key_t, val_t>& other) const {
         return m_node == other.m_node;
     }
@@ -214,20 +222,26 @@ public:
         return m_node != other.m_node;
     }
 
-    bool is_null() {
+    // orders nodes by address, used for deadlock free lock acquisition
+    bool operator<(const LNodeWrapper<key_t, val_t>& other) const {
+        return std::less<const LNode<key_t, val_t>*>()(operator->(), other.operator->());
+    }
+
+    bool is_null() const {
         return !static_cast<bool>(m_node);
     }
 
-    bool is_not_null() {
+    bool is_not_null() const {
         return static_cast<bool>(m_node);
     }
 
+    // the node was removed from the list (its DELETE bit)
     bool is_deleted() const {
-        return *deleted;
+        return m_node->isDeleted();
     }
 
+    // the node is freed with its last reference
     void delete_wrapped_node() {
-        *deleted = false;
     }
 
     LNode<key_t, val_t>* operator->() {
@@ -261,7 +275,6 @@ public:
 
 private:
     std::shared_ptr<LNode<key_t, val_t>> m_node;
-    std::shared_ptr<bool> deleted;
 };
 
 namespace std {
@@ -1,32 +1,20 @@
 #pragma once
 
-#include <memory>
-#include "../optional.h"
+#include <atomic>
+#include <utility>
 
+/**
+ * the node of the transactional queue, a singly linked list from head to tail.
+ * nodes are allocated and freed through RecordMgr (get_new_qnode / free_qnode)
+ */
 template <typename val_t>
 class QNode {
 public:
-    QNode(val_t val): m_val(val), m_prev(std::shared_ptr<QNode<val_t>>()), m_next(std::shared_ptr<QNode<val_t>>()) {
+    val_t m_val;
+    std::atomic<QNode<val_t>*> m_next;
 
-    }
+    //for debra we need the node to be defult ctr
+    QNode() : m_val(), m_next(nullptr) {}
 
-    QNode(val_t val, std::shared_ptr<QNode<val_t>> &prev, std::shared_ptr<QNode<val_t>> &next):
-    m_val(val), m_prev(prev), m_next(next) {
-
-    }
-
-    bool operator==(const QNode<val_t>& other) const {
-        return std::tie(m_val, m_prev.get(), m_next.get()) ==
-            std::tie(other.m_val, other.m_prev.get(), other.m_next.get());
-    }
-
-    bool operator!=(const QNode<val_t>& other) const {
-        return std::tie(m_val, m_prev.get(), m_next.get()) !=
-            std::tie(other.m_val, other.m_prev.get(), other.m_next.get());
-    }
-
-private:
-    std::shared_ptr<QNode<val_t>> m_prev;
-    std::shared_ptr<QNode<val_t>> m_next;
-    Optional<val_t> m_val;
+    explicit QNode(val_t val) : m_val(std::move(val)), m_next(nullptr) {}
 };
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "LNode.h"
+#include "LNodeWrapper.h"
+
+/**
+ * an older state of a list node, kept by multi version policies (TxPolicy::MULTI_VERSION) for the snapshots
+ * of read only transactions. a node's chain goes from its newest older state to its oldest one, every record
+ * holds the state the node had from m_version until the version of the record before it (or of the node).
+ * records are allocated and retired through RecordMgr and are immutable once linked, only the link to the
+ * records no snapshot can read any more is cut (see pushVersion). they are only valid under RecordMgr::getGuard()
+ */
+template <typename key_t, typename val_t>
+class VNode {
+public:
+    using node_t = LNodeWrapper<key_t,val_t>;
+
+    uint64_t m_version;
+    bool m_deleted;
+    node_t m_next;
+    Optional<val_t> m_val;
+    std::atomic<VNode*> m_older;
+
+    //for debra we need the node to be defult ctr
+    VNode() : m_version(0), m_deleted(false), m_next(), m_older(nullptr) { }
+
+    // the current state of n, which is locked
+    void init(node_t& n, VNode* older) {
+        m_version = n->getVersion();
+        m_deleted = n->isDeleted();
+        m_next = n->m_next;
+        m_val = n->m_val;
+        m_older.store(older, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * the list node of a multi version policy: an LNode with the chain of its older states.
+ * the record manager of such a policy (RecordMgr::versioned_t) allocates every list node as one,
+ * so the nodes of the other policies don't carry the pointer
+ */
+template <typename key_t, typename val_t>
+class VersionedLNode : public LNode<key_t, val_t> {
+public:
+    std::atomic<VNode<key_t, val_t>*> m_versions;
+
+    VersionedLNode() : m_versions(nullptr) { }
+
+    explicit VersionedLNode(key_t key) : LNode<key_t, val_t>(std::move(key)), m_versions(nullptr) {}
+
+    void reset(key_t key) {
+        LNode<key_t, val_t>::reset(std::move(key));
+        m_versions = nullptr;
+    }
+};
+
+// the chain of the node n, which has to be a node of a multi version policy
+template <typename key_t, typename val_t>
+std::atomic<VNode<key_t, val_t>*>& versionsOf(LNodeWrapper<key_t, val_t>& n) {
+    return static_cast<VersionedLNode<key_t, val_t>*>(n.operator->())->m_versions;
+}
+
+/**
+ * saves the current state of n (locked, about to be written at writeVersion) to its chain and retires the
+ * records no snapshot can read any more: a snapshot reads the newest record not newer than its read version,
+ * the snapshots that are running or start later read at oldestSnapshot or after (BasicTX::oldestSnapshot),
+ * so the chain is cut after the first record not newer than oldestSnapshot.
+ * a node that was inserted at writeVersion has no older state to keep
+ */
+template <typename key_t, typename val_t, typename record_mgr_t>
+void pushVersion(LNodeWrapper<key_t, val_t>& n, uint64_t writeVersion, uint64_t oldestSnapshot,
+                 const record_mgr_t& recordMgr) {
+    if (writeVersion <= oldestSnapshot) {
+        // every snapshot reads the state written now
+        recordMgr.retire_versions(versionsOf(n).exchange(nullptr));
+        return;
+    }
+    if (n->getVersion() == writeVersion) {
+        return;
+    }
+    auto newest = recordMgr.get_new_vnode(n, versionsOf(n).load(std::memory_order_relaxed));
+    auto last = newest;
+    while (last->m_version > oldestSnapshot) {
+        auto older = last->m_older.load(std::memory_order_relaxed);
+        if (older == nullptr) {
+            break;
+        }
+        last = older;
+    }
+    recordMgr.retire_versions(last->m_older.exchange(nullptr));
+    versionsOf(n).store(newest, std::memory_order_release);
+}
@@ -1,26 +1,167 @@
 #pragma once
 
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+// RECORD_MGR_STATS: the allocators and RecordMgr count allocations and frees per thread, for
+// RecordMgr::unreclaimed_bytes and RecordMgr::pool_stats. off by default, the counting is on the allocation path
+#if defined(RECORD_MGR_STATS) && !defined(MEMORY_STATS)
+#define MEMORY_STATS if(1)
+#define MEMORY_STATS2 if(0)
+#endif
+
 //debra
 #include <recordmgr/record_manager.h>
 #include <recordmgr/allocator_new.h>
 
 #include "LNodeWrapper.h"
+#include "QNode.h"
+#include "IndexNode.h"
+#include "VNode.h"
 
-#ifdef DEBRA
-template <typename key_t, typename val_t>
+/**
+ * the reclaimer of the build: DEBRA, or RECLAIM_EBR (tree EBR), RECLAIM_DEBRACAP (DEBRA with a bounded
+ * number of limbo bags), RECLAIM_NONE (retired records are never freed, for comparison)
+ */
+#if defined(RECLAIM_EBR)
+template <typename T> using default_reclaimer_t = reclaimer_tree_ebr<T>;
+#elif defined(RECLAIM_DEBRACAP)
+template <typename T> using default_reclaimer_t = reclaimer_debracap<T>;
+#elif defined(RECLAIM_NONE)
+template <typename T> using default_reclaimer_t = reclaimer_none<T>;
+#else
+template <typename T> using default_reclaimer_t = reclaimer_debra<T>;
+#endif
+
+/**
+ * reclaimed records go to a per thread free bag (and a shared bag when it has too many) and are reused by
+ * the next allocations, POOL_NONE gives every record back to the allocator
+ */
+#if defined(POOL_NONE)
+template <typename T> using default_pool_t = pool_none<T>;
+#else
+template <typename T> using default_pool_t = pool_perthread_and_shared<T>;
+#endif
+
+/**
+ * the data structures only protect their records with RecordMgr::getGuard (an epoch), so a reclaimer has to
+ * keep every record retired during a guard until the guard ends. hazard pointers free any record no thread
+ * announced (nothing is announced, and a transaction's read set is unbounded), DEBRA+ restarts an operation
+ * with a signal (which would leak the node locks of a commit), so both are rejected
+ */
+template <typename Reclaim>
+struct is_epoch_reclaimer : std::true_type {};
+
+template <typename T, typename Pool>
+struct is_epoch_reclaimer<reclaimer_hazardptr<T, Pool>> : std::false_type {};
+
+template <typename T, typename Pool>
+struct is_epoch_reclaimer<reclaimer_debraplus<T, Pool>> : std::false_type {};
+
+// RECLAIM_NONE never frees a retired record
+template <typename Reclaim>
+struct reclaims_records : std::true_type {};
+
+template <typename T, typename Pool>
+struct reclaims_records<reclaimer_none<T, Pool>> : std::false_type {};
+
+/**
+ * the per thread handle of the record manager.
+ * index and queue nodes (and the older versions of list nodes) always go through the record manager. the list nodes only do in the DEBRA build,
+ * the other builds keep them in their LNodeWrapper (shared_ptr or leaked raw pointer)
+ * @tparam Reclaim, Alloc, Pool  the record manager policies (common/recordmgr), the defaults are the ones of the build
+ * @tparam Node                  the list node type, VersionedLNode for multi version policies (see versioned_t)
+ */
+template <typename key_t, typename val_t,
+          typename Reclaim = default_reclaimer_t<key_t>,
+          typename Alloc = allocator_new<key_t>,
+          typename Pool = default_pool_t<key_t>,
+          typename Node = LNode<key_t, val_t>>
 class RecordMgr {
 public:
-    using node_t = LNode<key_t, val_t>;
-    using record_manager_t = record_manager<reclaimer_debra<key_t>, allocator_new<key_t>, pool_none<key_t>, node_t>;
+    using node_t = Node;
+    using qnode_t = QNode<val_t>;
+    using index_node_t = IndexNode<key_t, val_t>;
+    using head_index_t = HeadIndex<key_t, val_t>;
+    using vnode_t = VNode<key_t, val_t>;
+    using record_manager_t = record_manager<Reclaim, Alloc, Pool, node_t, qnode_t, index_node_t, head_index_t,
+                                            vnode_t>;
+
+    static_assert(is_epoch_reclaimer<Reclaim>::value, "the data structures only support epoch based reclaimers");
+    static_assert(std::is_base_of<LNode<key_t, val_t>, Node>::value, "the list nodes are LNodes");
+
+    // the same record manager with the list nodes of a multi version policy (TX picks it for such a policy)
+    using versioned_t = RecordMgr<key_t, val_t, Reclaim, Alloc, Pool, VersionedLNode<key_t, val_t>>;
+
+#ifdef RECORD_MGR_STATS
+    static constexpr bool STATS = true;
+#else
+    static constexpr bool STATS = false; // pool_stats and unreclaimed_bytes stay zero
+#endif
+
+    // allocations, and how many of them reused a record from the pool
+    struct PoolStats {
+        long requests = 0;
+        long hits = 0;
+
+        double hitRate() const {
+            return requests ? static_cast<double>(hits) / requests : 0;
+        }
+
+        PoolStats operator-(const PoolStats& other) const {
+            PoolStats res;
+            res.requests = requests - other.requests;
+            res.hits = hits - other.hits;
+            return res;
+        }
+    };
 
     static std::shared_ptr<record_manager_t> make_record_mgr(size_t max_threads) {
         return std::make_shared<record_manager_t>(max_threads);
     }
+
+    /**
+     * of all the record types, reads the counters without synchronization like unreclaimed_bytes.
+     * the pool takes a whole block of records from the allocator when its bag is empty, so the allocator
+     * counts blocks: the requests the fresh records of a block serve count as allocations too, hits is a
+     * lower bound (exact with POOL_NONE)
+     */
+    static PoolStats pool_stats(record_manager_t& recManager) {
+        PoolStats res;
+        add_pool_stats<node_t>(recManager, res);
+        add_pool_stats<qnode_t>(recManager, res);
+        add_pool_stats<index_node_t>(recManager, res);
+        add_pool_stats<head_index_t>(recManager, res);
+        add_pool_stats<vnode_t>(recManager, res);
+        return res;
+    }
+
+    /**
+     * the bytes of the records that were retired (or freed right away) and were neither freed nor reused yet
+     * (so records waiting in the pool count too). the fresh records of a block the pool took from the
+     * allocator (see pool_stats) hide as many reuses, so it's an upper bound by up to a block per thread and type.
+     * reads the counters of all threads without synchronization, so it's an estimate while they run
+     */
+    static size_t unreclaimed_bytes(record_manager_t& recManager) {
+        return unreclaimed<node_t>(recManager) * sizeof(node_t) +
+               unreclaimed<qnode_t>(recManager) * sizeof(qnode_t) +
+               unreclaimed<index_node_t>(recManager) * sizeof(index_node_t) +
+               unreclaimed<head_index_t>(recManager) * sizeof(head_index_t) +
+               unreclaimed<vnode_t>(recManager) * sizeof(vnode_t);
+    }
+
     RecordMgr(std::shared_ptr<record_manager_t> myRecManager, int tid) : myRecManager(myRecManager), tid(tid) {
         myRecManager->initThread(tid);
     }
 
     ~RecordMgr() {
+#ifdef DEBRA
+        for (auto& n : m_spare_nodes) {
+            deallocate(static_cast<node_t*>(n.delete_wrapped_node()));
+        }
+#endif
+        m_spare_nodes.clear();
         myRecManager->deinitThread(tid);
     }
 
@@ -30,11 +171,46 @@ public:
         return myRecManager->getGuard(tid);
     }
 
+    // getGuard in two calls, for a guard that spans the commit of several structures (TX::tryCommit)
+    void startOp() const {
+        myRecManager->startOp(tid);
+    }
+
+    void endOp() const {
+        myRecManager->endOp(tid);
+    }
+
+    static constexpr bool RECLAIMS = reclaims_records<Reclaim>::value;
+
+    // the thread ids of the record manager, 0 .. num_threads() - 1
+    int num_threads() const {
+        return myRecManager->NUM_PROCESSES;
+    }
+
+    /**
+     * other_tid holds no guard right now. for the objects that aren't records (TxHashMap's tables): an object
+     * no guard can reach any more is free once every thread that held a guard then was seen quiescent.
+     * the guard isn't fenced, the readers fence it before they read the object's pointer
+     */
+    bool is_quiescent(int other_tid) const {
+        return myRecManager->isQuiescent(other_tid);
+    }
+
+#ifdef DEBRA
     LNodeWrapper<key_t, val_t> get_new_node(key_t key) const {
-        auto myNode = myRecManager->template allocate<node_t>(tid);
-        myNode->m_key = key;
+        auto myNode = allocate<node_t>();
+        myNode->reset(std::move(key));
         return LNodeWrapper<key_t, val_t>(myNode);
     }
+#elif defined(UNSAFE)
+    LNodeWrapper<key_t, val_t> get_new_node(key_t key) const {
+        return LNodeWrapper<key_t, val_t>(new node_t(std::move(key)));
+    }
+#else
+    LNodeWrapper<key_t, val_t> get_new_node(key_t key) const {
+        return LNodeWrapper<key_t, val_t>(std::make_shared<node_t>(std::move(key)));
+    }
+#endif
 
     LNodeWrapper<key_t, val_t> get_new_node(key_t key, val_t val) const {
         auto n = get_new_node(key);
@@ -42,58 +218,145 @@ public:
         return n;
     }
 
-    void retire_node(LNodeWrapper<key_t, val_t> n) const {
-        auto inner_node = n.delete_wrapped_node();
-        myRecManager->retire(tid, inner_node);
+    /**
+     * a node for a transactional insert. the node stays private to the transaction until it commits,
+     * so an aborted transaction gives it back with recycle_node and the next insert of this thread reuses it
+     */
+    LNodeWrapper<key_t, val_t> get_tx_node(key_t key, val_t val) const {
+        if (m_spare_nodes.empty()) {
+            return get_new_node(std::move(key), std::move(val));
+        }
+        auto n = std::move(m_spare_nodes.back());
+        m_spare_nodes.pop_back();
+        static_cast<node_t*>(n.operator->())->reset(std::move(key));
+        n->m_val = std::move(val);
+        return n;
     }
 
-private:
-    std::shared_ptr<record_manager_t> myRecManager;
-    int tid;
-};
+    // a node of get_tx_node that was never linked (its transaction aborted)
+    void recycle_node(LNodeWrapper<key_t, val_t> n) const {
+        m_spare_nodes.push_back(std::move(n));
+    }
 
+    size_t spare_nodes() const {
+        return m_spare_nodes.size();
+    }
+
+#ifdef DEBRA
+    void retire_node(LNodeWrapper<key_t, val_t> n) const {
+        auto inner_node = static_cast<node_t*>(n.delete_wrapped_node());
+        retire_node_versions(inner_node);
+        retire(inner_node);
+    }
 #else
+    void retire_node(LNodeWrapper<key_t, val_t> n) const {
+        retire_node_versions(static_cast<node_t*>(n.operator->()));
+        n.delete_wrapped_node();
+    }
+#endif
 
-//a dummy class in case of no debra
-template <typename key_t, typename val_t>
-class RecordMgr {
-public:
-    using node_t = LNode<key_t, val_t>;
-    using record_manager_t = record_manager<reclaimer_debra<key_t>, allocator_new<key_t>, pool_none<key_t>, node_t>;
+    // the current state of the locked node n, in front of older
+    vnode_t* get_new_vnode(LNodeWrapper<key_t, val_t>& n, vnode_t* older) const {
+        auto myNode = allocate<vnode_t>();
+        myNode->init(n, older);
+        return myNode;
+    }
 
-    static std::shared_ptr<record_manager_t> make_record_mgr(size_t max_threads) {
-        return std::shared_ptr<record_manager_t>{};
+    // a chain of older versions that was cut off its node, freed once no guarded operation can still see it
+    void retire_versions(vnode_t* v) const {
+        while (v != nullptr) {
+            auto older = v->m_older.load(std::memory_order_relaxed);
+            retire(v);
+            v = older;
+        }
     }
 
-    RecordMgr(std::shared_ptr<record_manager_t> myRecManager, int tid) {
+    qnode_t* get_new_qnode(val_t val) const {
+        auto myNode = allocate<qnode_t>();
+        myNode->m_val = std::move(val);
+        myNode->m_next = nullptr;
+        return myNode;
     }
 
-    ~RecordMgr() {
+    // frees a queue node right away, the queue makes sure no one can still reach it
+    void free_qnode(qnode_t* n) const {
+        deallocate(n);
     }
 
-    RecordMgr(const RecordMgr&) = delete;
+    index_node_t* get_new_index_node(LNodeWrapper<key_t, val_t> node, index_node_t* down, index_node_t* right) const {
+        auto myNode = allocate<index_node_t>();
+        myNode->init(std::move(node), down, right);
+        return myNode;
+    }
 
-    size_t getGuard() const {
-        return 0;
+    head_index_t* get_new_head_index(LNodeWrapper<key_t, val_t> node, head_index_t* down, index_node_t* right, uint64_t level) const {
+        auto myNode = allocate<head_index_t>();
+        myNode->init(std::move(node), down, right, level);
+        return myNode;
     }
 
-    LNodeWrapper<key_t, val_t> get_new_node(key_t key) const {
-        return LNodeWrapper<key_t, val_t>(std::move(key));
+    // an index node that was unlinked, freed once no guarded operation can still see it
+    void retire_index_node(index_node_t* n) const {
+        retire(n);
     }
 
-    LNodeWrapper<key_t, val_t> get_new_node(key_t key, val_t val) const {
-        auto n = get_new_node(key);
-        n->m_val = val;
-        return n;
+    void retire_index_node(head_index_t* n) const {
+        retire(n);
     }
 
-    void retire_node(LNodeWrapper<key_t, val_t> n) const {
-        n.delete_wrapped_node();
+    // an index node that was never linked (or at deinit)
+    void free_index_node(index_node_t* n) const {
+        deallocate(n);
+    }
+
+    void free_index_node(head_index_t* n) const {
+        deallocate(n);
     }
 
 private:
+    // the nodes of a single version policy have no chain
+    void retire_node_versions(LNode<key_t, val_t>*) const {}
+
+    void retire_node_versions(VersionedLNode<key_t, val_t>* n) const {
+        retire_versions(n->m_versions.exchange(nullptr));
+    }
+
+    // the allocator counts the records it allocated (a block at a time, see pool_stats), the pool served the rest
+    template <typename T>
+    T* allocate() const {
+        MEMORY_STATS myRecManager->getDebugInfo((T*) nullptr)->addFromPool(tid, 1);
+        return myRecManager->template allocate<T>(tid);
+    }
+
+    // the allocator counts the frees, the retires are counted here (records freed right away count as retired too)
+    template <typename T>
+    void retire(T* n) const {
+        MEMORY_STATS myRecManager->getDebugInfo((T*) nullptr)->addRetired(tid, 1);
+        myRecManager->retire(tid, n);
+    }
+
+    template <typename T>
+    void deallocate(T* n) const {
+        MEMORY_STATS myRecManager->getDebugInfo((T*) nullptr)->addRetired(tid, 1);
+        myRecManager->deallocate(tid, n);
+    }
+
+    template <typename T>
+    static long unreclaimed(record_manager_t& recManager) {
+        auto debugInfo = recManager.getDebugInfo((T*) nullptr);
+        long reused = std::max(0L, debugInfo->getTotalFromPool() - debugInfo->getTotalAllocated());
+        return std::max(0L, debugInfo->getTotalRetired() - debugInfo->getTotalDeallocated() - reused);
+    }
+
+    template <typename T>
+    static void add_pool_stats(record_manager_t& recManager, PoolStats& stats) {
+        auto debugInfo = recManager.getDebugInfo((T*) nullptr);
+        long requests = debugInfo->getTotalFromPool();
+        stats.requests += requests;
+        stats.hits += std::max(0L, requests - debugInfo->getTotalAllocated());
+    }
+
     std::shared_ptr<record_manager_t> myRecManager;
     int tid;
+    mutable std::vector<LNodeWrapper<key_t, val_t>> m_spare_nodes; // unlinked nodes of aborted transactions
 };
-
-#endif
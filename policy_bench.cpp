@@ -0,0 +1,162 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "datatypes/LinkedList.h"
+
+/**
+ * the same contended workload under several TX configurations (see TxPolicy.h), side by side in one binary:
+ * n_threads threads run 50% get / 50% put transactions on n_keys keys (TX::run, until they commit).
+ * then a reporting scan: one thread sums all the keys in read only transactions while the others write,
+ * with and without the older versions of multi version policies
+ * usage: policy_bench [n_threads] [n_keys] [n_tx_per_thread] [ops_per_tx]
+ */
+
+struct Gv4Policy : DefaultTxPolicy {
+    using Clock = GV4Clock;
+};
+
+struct SortedSpinPolicy : DefaultTxPolicy {
+    static constexpr CommitLockMode LOCK_MODE = CommitLockMode::SORTED_SPIN;
+};
+
+struct NoStatsPolicy : DefaultTxPolicy {
+    static constexpr bool ABORT_STATS = false;
+};
+
+struct MultiVersionPolicy : DefaultTxPolicy {
+    static constexpr bool MULTI_VERSION = true;
+};
+
+struct EbrPolicy : DefaultTxPolicy {
+    template <typename key_t, typename val_t>
+    using record_mgr = RecordMgr<key_t, val_t, reclaimer_tree_ebr<key_t>>;
+};
+
+template <typename Policy>
+void benchContended(const std::string& name, size_t n_threads, size_t n_keys, size_t n_tx, size_t ops_per_tx) {
+    using list_t = LinkedList<size_t, size_t, Policy>;
+    using record_mgr_t = typename list_t::record_mgr_t;
+    auto global_record_mgr = record_mgr_t::make_record_mgr(n_threads + 1);
+    auto tx = std::make_shared<BasicTX<Policy>>();
+    record_mgr_t record_mgr(global_record_mgr, 0);
+    list_t l(tx, record_mgr);
+    for (size_t k = 1; k <= n_keys; k++) {
+        l.put(k, k, record_mgr);
+    }
+
+    auto stats_before = AbortStats::snapshot();
+    std::atomic<size_t> aborts(0);
+    std::vector<std::thread> threads;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (size_t t = 0; t < n_threads; t++) {
+        threads.emplace_back([&, t] {
+            record_mgr_t thread_record_mgr(global_record_mgr, t + 1);
+            std::mt19937_64 rng(t + 1);
+            std::uniform_int_distribution<size_t> key_dist(1, n_keys);
+            size_t my_aborts = 0;
+            for (size_t i = 0; i < n_tx; i++) {
+                tx->run([&] {
+                    for (size_t op = 0; op < ops_per_tx; op++) {
+                        size_t key = key_dist(rng);
+                        if (rng() % 2 == 0) {
+                            l.put(key, key, thread_record_mgr);
+                        } else {
+                            l.get(key, thread_record_mgr);
+                        }
+                    }
+                }, RetryPolicy(), thread_record_mgr);
+                my_aborts += tx->lastRunStats().attempts - 1;
+            }
+            aborts += my_aborts;
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start_time;
+    size_t commits = n_threads * n_tx;
+    std::cout << name << ": " << commits / time.count() << " commits/sec, "
+              << static_cast<double>(aborts) / commits << " aborts/commit, "
+              << (AbortStats::snapshot() - stats_before).total() << " aborts counted" << std::endl;
+    l.deinit_list(record_mgr);
+}
+
+template <typename Policy>
+void benchScans(const std::string& name, size_t n_threads, size_t n_keys, size_t n_tx, size_t ops_per_tx) {
+    using list_t = LinkedList<size_t, size_t, Policy>;
+    using record_mgr_t = typename list_t::record_mgr_t;
+    auto global_record_mgr = record_mgr_t::make_record_mgr(n_threads + 2);
+    auto tx = std::make_shared<BasicTX<Policy>>();
+    record_mgr_t record_mgr(global_record_mgr, 0);
+    list_t l(tx, record_mgr);
+    for (size_t k = 1; k <= n_keys; k++) {
+        l.put(k, k, record_mgr);
+    }
+
+    std::atomic<size_t> writers(n_threads);
+    size_t scans = 0;
+    size_t aborts = 0;
+    std::vector<std::thread> threads;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (size_t t = 0; t < n_threads; t++) {
+        threads.emplace_back([&, t] {
+            record_mgr_t thread_record_mgr(global_record_mgr, t + 1);
+            std::mt19937_64 rng(t + 1);
+            std::uniform_int_distribution<size_t> key_dist(1, n_keys);
+            for (size_t i = 0; i < n_tx; i++) {
+                tx->run([&] {
+                    for (size_t op = 0; op < ops_per_tx; op++) {
+                        size_t key = key_dist(rng);
+                        l.put(key, key, thread_record_mgr);
+                    }
+                }, RetryPolicy(), thread_record_mgr);
+            }
+            writers--;
+        });
+    }
+    threads.emplace_back([&] {
+        record_mgr_t thread_record_mgr(global_record_mgr, n_threads + 1);
+        std::vector<std::pair<size_t, size_t>> out;
+        while (writers != 0) {
+            tx->TXbeginReadOnly();
+            if (l.tryRangeQuery(1, n_keys, out, thread_record_mgr) && tx->tryCommit(thread_record_mgr)) {
+                scans++;
+            } else {
+                tx->handle_abort(thread_record_mgr);
+                aborts++;
+            }
+        }
+    });
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> time = std::chrono::high_resolution_clock::now() - start_time;
+    std::cout << name << ": " << scans / time.count() << " scans/sec, " << aborts << " aborted scans" << std::endl;
+    l.deinit_list(record_mgr);
+}
+
+int main(int argc, char *argv[]) {
+    size_t n_threads = argc > 1 ? std::atoi(argv[1]) : 4;
+    size_t n_keys = argc > 2 ? std::atoi(argv[2]) : 64;
+    size_t n_tx = argc > 3 ? std::atoi(argv[3]) : 20000;
+    size_t ops_per_tx = argc > 4 ? std::atoi(argv[4]) : 4;
+
+    std::cout << n_threads << " threads, " << n_keys << " keys, " << ops_per_tx << " ops per transaction"
+              << std::endl;
+    benchContended<DefaultTxPolicy>("default", n_threads, n_keys, n_tx, ops_per_tx);
+    benchContended<Gv4Policy>("GV4 clock", n_threads, n_keys, n_tx, ops_per_tx);
+    benchContended<SortedSpinPolicy>("sorted spin commit", n_threads, n_keys, n_tx, ops_per_tx);
+    benchContended<NoStatsPolicy>("no abort stats", n_threads, n_keys, n_tx, ops_per_tx);
+    benchContended<EbrPolicy>("EBR reclaimer", n_threads, n_keys, n_tx, ops_per_tx);
+    benchContended<MultiVersionPolicy>("multi version", n_threads, n_keys, n_tx, ops_per_tx);
+
+    std::cout << "reporting scans of " << n_keys << " keys, " << n_threads << " writers" << std::endl;
+    benchScans<DefaultTxPolicy>("default", n_threads, n_keys, n_tx, ops_per_tx);
+    benchScans<MultiVersionPolicy>("multi version", n_threads, n_keys, n_tx, ops_per_tx);
+    return 0;
+}
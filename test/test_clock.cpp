@@ -0,0 +1,35 @@
+#include <gtest/gtest.h>
+#include "../GlobalClock.h"
+
+template <typename clock_t>
+class ClockTest : public ::testing::Test {};
+
+using Clocks = ::testing::Types<GV1Clock, GV4Clock, GV5Clock, GV6Clock, TscClock>;
+TYPED_TEST_SUITE(ClockTest, Clocks);
+
+TYPED_TEST(ClockTest, commitIsNewerThanEarlierReads) {
+    TypeParam clock;
+    for (int i = 0; i < 100; i++) {
+        auto rv = clock.read();
+        auto wv = clock.commit();
+        EXPECT_GT(wv, rv);
+        // a transaction that saw wv and aborted must be able to start at wv
+        clock.observe(wv);
+        EXPECT_GE(clock.read(), wv);
+    }
+}
+
+TYPED_TEST(ClockTest, bumpAdvances) {
+    TypeParam clock;
+    auto v = clock.read();
+    EXPECT_GT(clock.bump(), v);
+    EXPECT_GT(clock.read(), v);
+}
+
+TEST(GV5Clock, commitDoesNotWrite) {
+    GV5Clock clock;
+    auto rv = clock.read();
+    EXPECT_EQ(clock.commit(), rv + 1);
+    EXPECT_EQ(clock.commit(), rv + 1);
+    EXPECT_EQ(clock.read(), rv);
+}
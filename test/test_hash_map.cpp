@@ -0,0 +1,230 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include "../datatypes/TxHashMap.h"
+
+TEST(TxHashMap, putGetRemove) {
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        TxHashMap<size_t, size_t> m(tx, record_mgr, 4);
+        // singleton
+        EXPECT_EQ(m.put(1, 10, record_mgr), NULLOPT);
+        EXPECT_EQ(m.put(1, 11, record_mgr), 10);
+        EXPECT_EQ(m.putIfAbsent(1, 12, record_mgr), 11);
+        EXPECT_EQ(m.get(1, record_mgr), 11);
+        EXPECT_TRUE(m.containsKey(1, record_mgr));
+        // TX
+        tx->TXbegin();
+        for (size_t i = 2; i <= 20; i++) {
+            m.put(i, i * 10, record_mgr);
+        }
+        EXPECT_EQ(m.remove(1, record_mgr), 11);
+        EXPECT_EQ(m.get(1, record_mgr), NULLOPT);
+        EXPECT_EQ(m.get(5, record_mgr), 50);
+        tx->TXend<size_t, size_t>(record_mgr);
+        EXPECT_EQ(m.get_size(), 19);
+        EXPECT_FALSE(m.containsKey(1, record_mgr));
+        EXPECT_EQ(m.remove(2, record_mgr), 20);
+        EXPECT_EQ(m.get_size(), 18);
+        m.deinit_map(record_mgr);
+    }).join();
+}
+
+TEST(TxHashMap, resizeKeepsKeys) {
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        TxHashMap<size_t, size_t> m(tx, record_mgr, 2, 4);
+        for (size_t i = 1; i <= 100; i++) {
+            m.put(i, i, record_mgr);
+        }
+        // grown on the inserts
+        EXPECT_GE(m.get_n_buckets(), 32);
+        EXPECT_TRUE(m.resize(3, record_mgr));
+        EXPECT_EQ(m.get_n_buckets(), 3);
+        EXPECT_EQ(m.get_size(), 100);
+        for (size_t i = 1; i <= 100; i++) {
+            EXPECT_EQ(m.get(i, record_mgr), i);
+        }
+        m.deinit_map(record_mgr);
+    }).join();
+}
+
+TEST(TxHashMap, abortedInsertsDontGrow) {
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        TxHashMap<size_t, size_t> m(tx, record_mgr, 2, 4);
+        // far more inserts than 2 * 4 keys, none of them committed
+        for (size_t attempt = 0; attempt < 20; attempt++) {
+            tx->TXbegin();
+            for (size_t i = 1; i <= 3; i++) {
+                m.put(i, i, record_mgr);
+            }
+            tx->handle_abort<size_t, size_t>(record_mgr);
+        }
+        m.put(1, 1, record_mgr);
+        EXPECT_EQ(m.get_n_buckets(), 2);
+        EXPECT_EQ(m.get_size(), 1);
+        m.deinit_map(record_mgr);
+    }).join();
+}
+
+TEST(TxHashMap, insertsMovePartOfTheResize) {
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        TxHashMap<size_t, size_t> m(tx, record_mgr, 8, 1);
+        for (size_t i = 1; i <= 8; i++) {
+            m.put(i, i, record_mgr);
+        }
+        // the 9th insert starts the resize, it and the next ones move 2 of the 8 buckets each
+        for (size_t i = 9; i <= 12; i++) {
+            EXPECT_EQ(m.get_n_buckets(), 8);
+            m.put(i, i, record_mgr);
+            for (size_t j = 1; j <= i; j++) {
+                EXPECT_EQ(m.get(j, record_mgr), j);
+            }
+        }
+        EXPECT_EQ(m.get_n_buckets(), 16);
+        EXPECT_EQ(m.get_size(), 12);
+        if (RecordMgr<size_t, size_t>::RECLAIMS) {
+            // no one else held a guard, the old table is freed right away
+            EXPECT_EQ(m.get_n_retired_tables(), 0);
+        }
+        m.deinit_map(record_mgr);
+    }).join();
+}
+
+TEST(TxHashMap, retiredTableWaitsForTransactions) {
+    if (!RecordMgr<size_t, size_t>::RECLAIMS) {
+        GTEST_SKIP() << "RECLAIM_NONE frees the tables at deinit_map";
+    }
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(2);
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        TxHashMap<size_t, size_t> m(tx, record_mgr, 4, 100);
+        m.put(1, 1, record_mgr);
+        std::atomic<int> stage(0);
+        // a transaction that read the old table, still running when the resize ends
+        std::thread reader([&] {
+            RecordMgr<size_t, size_t> record_mgr1(global_record_mgr, 1);
+            tx->TXbegin();
+            EXPECT_EQ(m.get(1, record_mgr1), 1);
+            stage = 1;
+            while (stage != 2) {
+                std::this_thread::yield();
+            }
+            try {
+                tx->TXend<size_t, size_t>(record_mgr1);
+            } catch (TxAbortException&) {
+                tx->handle_abort<size_t, size_t>(record_mgr1);
+            }
+        });
+        while (stage != 1) {
+            std::this_thread::yield();
+        }
+        EXPECT_TRUE(m.resize(8, record_mgr));
+        EXPECT_EQ(m.get_n_retired_tables(), 1);
+        m.put(2, 2, record_mgr);
+        EXPECT_EQ(m.get_n_retired_tables(), 1);
+        stage = 2;
+        reader.join();
+        // the next insert frees it
+        m.put(3, 3, record_mgr);
+        EXPECT_EQ(m.get_n_retired_tables(), 0);
+        EXPECT_EQ(m.get(1, record_mgr), 1);
+        m.deinit_map(record_mgr);
+    }).join();
+}
+
+TEST(TxHashMap, resizeAbortsTransaction) {
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(2);
+    std::unique_ptr<TxHashMap<size_t, size_t>> m;
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        m = std::make_unique<TxHashMap<size_t, size_t>>(tx, record_mgr, 1);
+        m->put(1, 1, record_mgr);
+        tx->TXbegin();
+        m->put(2, 2, record_mgr);
+        // the bucket is moved before we commit
+        std::thread([&] {
+            RecordMgr<size_t, size_t> record_mgr2(global_record_mgr, 1);
+            EXPECT_TRUE(m->resize(4, record_mgr2));
+        }).join();
+        EXPECT_THROW((tx->TXend<size_t, size_t>(record_mgr)), TxAbortException);
+        tx->handle_abort<size_t, size_t>(record_mgr);
+        EXPECT_EQ(m->get(2, record_mgr), NULLOPT);
+        EXPECT_EQ(m->get(1, record_mgr), 1);
+        m->deinit_map(record_mgr);
+    }).join();
+}
+
+TEST(TxHashMapMT, resizeDuringTransfers) {
+    const size_t n_keys = 64;
+    const size_t n_writers = 3;
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(n_writers + 2);
+    std::unique_ptr<TxHashMap<size_t, size_t>> m;
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        m = std::make_unique<TxHashMap<size_t, size_t>>(tx, record_mgr, 2);
+        tx->TXbegin();
+        for (size_t i = 1; i <= n_keys; i++) {
+            m->put(i, 100, record_mgr);
+        }
+        tx->TXend<size_t, size_t>(record_mgr);
+    }).join();
+
+    // writers move one unit between two keys while the table is resized, the sum never changes
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < n_writers; w++) {
+        threads.emplace_back([&, w] {
+            RecordMgr<size_t, size_t> record_mgr(global_record_mgr, w + 1);
+            for (size_t i = 0; i < 500; i++) {
+                size_t from = (i * 7 + w) % n_keys + 1;
+                size_t to = (i * 5 + w + 3) % n_keys + 1;
+                if (from == to) continue;
+                try {
+                    tx->TXbegin();
+                    size_t from_val = m->get(from, record_mgr);
+                    size_t to_val = m->get(to, record_mgr);
+                    m->put(from, from_val - 1, record_mgr);
+                    m->put(to, to_val + 1, record_mgr);
+                    tx->TXend<size_t, size_t>(record_mgr);
+                } catch (TxAbortException&) {
+                    tx->handle_abort<size_t, size_t>(record_mgr);
+                }
+            }
+        });
+    }
+    threads.emplace_back([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, n_writers + 1);
+        for (size_t n_buckets : {8, 3, 32, 5}) {
+            EXPECT_TRUE(m->resize(n_buckets, record_mgr));
+        }
+    });
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        EXPECT_EQ(m->get_n_buckets(), 5);
+        EXPECT_EQ(m->get_size(), n_keys);
+        size_t sum = 0;
+        for (size_t i = 1; i <= n_keys; i++) {
+            size_t val = m->get(i, record_mgr);
+            sum += val;
+        }
+        EXPECT_EQ(sum, n_keys * 100);
+        m->deinit_map(record_mgr);
+    }).join();
+}
@@ -1,4 +1,6 @@
 #include <gtest/gtest.h>
+#include <thread>
+#include <vector>
 #include "../nodes/Index.h"
 #include "../nodes/record_mgr.h"
 
@@ -7,12 +9,13 @@ TEST(IndexBasic, putAndRemoveMulti) {
     auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
     RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
     auto n = record_mgr.get_new_node(std::numeric_limits<size_t>::min(), std::numeric_limits<size_t>::min());
-    Index<size_t, size_t> ind(n);
+    auto guard = record_mgr.getGuard();
+    Index<size_t, size_t> ind(n, record_mgr);
     std::vector<node_t> nodes(32);
     for (size_t i = 0; i < 32; i++) {
         auto n = record_mgr.get_new_node(i+1,  i+1);
         nodes[i] = n;
-        ind.add(n);
+        ind.add(n, record_mgr);
     }
     std::cout << "before remove" << std::endl;
     std::cout << ind << std::endl;
@@ -20,10 +23,116 @@ TEST(IndexBasic, putAndRemoveMulti) {
     for (size_t i = 0; i < 32; i++) {
         auto n = nodes[i];
         n->m_val = NULLOPT;
-        ind.remove(n);
+        ind.remove(n, record_mgr);
     }
     std::cout << "after remove" << std::endl;
     std::cout << ind << std::endl;
+    ind.deinit(record_mgr);
+}
+
+TEST(IndexBasic, getPredSkipsRemoved) {
+    using node_t = LNodeWrapper<size_t,size_t>;
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+    RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+    auto head = record_mgr.get_new_node(std::numeric_limits<size_t>::min(), std::numeric_limits<size_t>::min());
+    auto guard = record_mgr.getGuard();
+    Index<size_t, size_t> ind(head, record_mgr);
+    std::vector<node_t> nodes(256);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodes[i] = record_mgr.get_new_node(2 * (i + 1), i + 1);
+        ind.add(nodes[i], record_mgr);
+    }
+    for (size_t i = 0; i < nodes.size(); i++) {
+        EXPECT_LT(ind.getPred(2 * (i + 1) + 1, record_mgr)->m_key, 2 * (i + 1) + 1);
+    }
+    // remove every odd node, its index nodes get unlinked and retired
+    for (size_t i = 1; i < nodes.size(); i += 2) {
+        nodes[i]->m_val = NULLOPT;
+        ind.remove(nodes[i], record_mgr);
+    }
+    for (size_t i = 1; i < nodes.size(); i += 2) {
+        auto pred = ind.getPred(2 * (i + 1) + 1, record_mgr);
+        EXPECT_TRUE(pred->m_val);
+        EXPECT_LT(pred->m_key, 2 * (i + 1));
+    }
+    ind.deinit(record_mgr);
+}
+
+TEST(IndexBasic, retiredIndexNodesAreUnreclaimed) {
+    using record_mgr_t = RecordMgr<size_t, size_t>;
+    if (!record_mgr_t::STATS) {
+        GTEST_SKIP() << "the counters need RECORD_MGR_STATS";
+    }
+    auto global_record_mgr = record_mgr_t::make_record_mgr(1);
+    record_mgr_t record_mgr(global_record_mgr, 0);
+    auto n = record_mgr.get_new_node(1, 1);
+    std::vector<record_mgr_t::index_node_t*> nodes;
+#ifndef POOL_NONE
+    // the pool takes a block of records from the allocator at a time, the counters are exact once it's used up
+    nodes.resize(BLOCK_SIZE);
+    for (auto& in : nodes) {
+        in = record_mgr.get_new_index_node(n, nullptr, nullptr);
+    }
+    for (auto in : nodes) {
+        record_mgr.free_index_node(in);
+    }
+    // they wait in the pool until the next allocations reuse them
+    EXPECT_EQ(record_mgr_t::unreclaimed_bytes(*global_record_mgr), BLOCK_SIZE * sizeof(record_mgr_t::index_node_t));
+    for (auto& in : nodes) {
+        in = record_mgr.get_new_index_node(n, nullptr, nullptr);
+    }
+    EXPECT_EQ(record_mgr_t::pool_stats(*global_record_mgr).hits, BLOCK_SIZE);
+    auto second = nodes.back();
+    nodes.pop_back();
+#else
+    record_mgr.free_index_node(record_mgr.get_new_index_node(n, nullptr, nullptr));
+    auto second = record_mgr.get_new_index_node(n, nullptr, nullptr);
+#endif
+    EXPECT_EQ(record_mgr_t::unreclaimed_bytes(*global_record_mgr), 0);
+    {
+        auto guard = record_mgr.getGuard();
+        record_mgr.retire_index_node(second);
+        EXPECT_EQ(record_mgr_t::unreclaimed_bytes(*global_record_mgr), sizeof(record_mgr_t::index_node_t));
+    }
+    for (auto in : nodes) {
+        record_mgr.free_index_node(in);
+    }
+    auto guard = record_mgr.getGuard();
+    record_mgr.retire_node(n);
+}
+
+TEST(IndexBasic, removedLevelsAreRetired) {
+    using record_mgr_t = RecordMgr<size_t, size_t>;
+    if (!record_mgr_t::STATS) {
+        GTEST_SKIP() << "the counters need RECORD_MGR_STATS";
+    }
+    auto global_record_mgr = record_mgr_t::make_record_mgr(1);
+    record_mgr_t record_mgr(global_record_mgr, 0);
+    auto head = record_mgr.get_new_node(std::numeric_limits<size_t>::min(), std::numeric_limits<size_t>::min());
+    auto head_stats = global_record_mgr->getDebugInfo((record_mgr_t::head_index_t*) nullptr);
+    std::vector<LNodeWrapper<size_t,size_t>> nodes(256);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodes[i] = record_mgr.get_new_node(i + 1, i + 1);
+    }
+    Index<size_t, size_t> ind(head, record_mgr);
+    // every round grows the index and empties it again, the levels it drops go back to the record manager
+    for (size_t round = 0; round < 20; round++) {
+        auto guard = record_mgr.getGuard();
+        auto retired = head_stats->getTotalRetired();
+        for (auto& n : nodes) {
+            n->m_val = n->m_key;
+            ind.add(n, record_mgr);
+        }
+        for (auto& n : nodes) {
+            n->m_val = NULLOPT;
+            ind.remove(n, record_mgr);
+        }
+        EXPECT_GT(head_stats->getTotalRetired(), retired);
+        // the heads still in use, not one per level the index ever had
+        EXPECT_LT(head_stats->getTotalFromPool() - head_stats->getTotalRetired(), 16);
+    }
+    auto guard = record_mgr.getGuard();
+    ind.deinit(record_mgr);
 }
 
 //TEST(IndexBasic, insertionPoint) {
@@ -49,3 +158,47 @@ TEST(IndexBasic, putAndRemoveMulti) {
 //        std::cout << "level: " << i << "prev: " << prevs[i]->m_node << "next: " << nexts[i]->m_node << std::endl;
 //    }
 //}
+
+TEST(IndexConcurrent, addAndRemove) {
+    using node_t = LNodeWrapper<size_t,size_t>;
+    const size_t n_threads = 4;
+    const size_t n_per_thread = 500;
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(n_threads + 1);
+    RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+    auto head = record_mgr.get_new_node(std::numeric_limits<size_t>::min(), std::numeric_limits<size_t>::min());
+    Index<size_t, size_t> ind(head, record_mgr);
+    std::vector<node_t> nodes(n_threads * n_per_thread);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodes[i] = record_mgr.get_new_node(i + 1, i + 1);
+    }
+
+    // thread t adds the keys that are t modulo n_threads and removes the odd ones among them
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < n_threads; t++) {
+        threads.emplace_back([&, t] {
+            RecordMgr<size_t, size_t> thread_record_mgr(global_record_mgr, t + 1);
+            for (size_t i = t; i < nodes.size(); i += n_threads) {
+                auto guard = thread_record_mgr.getGuard();
+                ind.add(nodes[i], thread_record_mgr);
+            }
+            for (size_t i = t; i < nodes.size(); i += n_threads) {
+                if (nodes[i]->m_key % 2 == 1) {
+                    auto guard = thread_record_mgr.getGuard();
+                    nodes[i]->m_val = NULLOPT;
+                    ind.remove(nodes[i], thread_record_mgr);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto guard = record_mgr.getGuard();
+    for (size_t i = 0; i < nodes.size(); i++) {
+        auto pred = ind.getPred(nodes[i]->m_key, record_mgr);
+        EXPECT_TRUE(pred->m_val);
+        EXPECT_LT(pred->m_key, nodes[i]->m_key);
+    }
+    ind.deinit(record_mgr);
+}
@@ -1,4 +1,8 @@
 #include <gtest/gtest.h>
+#include <atomic>
+#include <functional>
+#include <type_traits>
+#include <thread>
 #include "../datatypes/LinkedList.h"
 
 TEST(LinkedListTransction, putOne) {
@@ -44,3 +48,743 @@ TEST(LinkedListTransction, putMany) {
     EXPECT_EQ(l.get(2, record_mgr), 6);
     EXPECT_EQ(l.get(8, record_mgr), 10);
 }
+
+TEST(LinkedListTransction, putManyCommit) {
+    // run on a fresh thread, the tests above leave their thread local transaction open
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        // enough writes for the write set to switch from linear scan to its hash index
+        for (int round = 0; round < 2; round++) {
+            tx->TXbegin();
+            for (size_t i = 1; i <= 100; i++) {
+                l.put(i, i * 2 + round, record_mgr);
+            }
+            for (size_t i = 1; i <= 100; i++) {
+                EXPECT_EQ(l.get(i, record_mgr), i * 2 + round);
+            }
+            tx->TXend<size_t, size_t>(record_mgr);
+        }
+        tx->TXbegin();
+        for (size_t i = 1; i <= 100; i += 2) {
+            EXPECT_EQ(l.remove(i, record_mgr), i * 2 + 1);
+        }
+        tx->TXend<size_t, size_t>(record_mgr);
+        EXPECT_EQ(l.get_size(), 50);
+        for (size_t i = 1; i <= 100; i++) {
+            EXPECT_EQ(l.get(i, record_mgr) == NULLOPT, i % 2 == 1);
+        }
+    });
+    t.join();
+}
+
+TEST(LinkedListTransction, writeSetSignature) {
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        tx->TXbegin();
+        for (size_t i = 1; i <= 50; i++) {
+            l.put(i, i, record_mgr);
+        }
+        tx->TXend<size_t, size_t>(record_mgr);
+
+        auto& writeSet = tx->get_local_storge<size_t, size_t>().writeSet;
+        auto before = writeSet.filterStats();
+        tx->TXbegin();
+        l.put(25, 0, record_mgr);
+        // traversing past the nodes that are not in the write set is answered by the signature
+        EXPECT_EQ(l.get(50, record_mgr), 50);
+        EXPECT_EQ(l.get(25, record_mgr), 0);
+        auto after = writeSet.filterStats();
+        EXPECT_GT(after.filtered, before.filtered);
+        tx->TXend<size_t, size_t>(record_mgr);
+    });
+    t.join();
+}
+
+TEST(LinkedListTransction, sortedSpinCommit) {
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>(TX::CommitLockMode::SORTED_SPIN, 64);
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        tx->TXbegin();
+        for (size_t i = 40; i > 0; i--) {
+            l.put(i, i, record_mgr);
+        }
+        tx->TXend<size_t, size_t>(record_mgr);
+        tx->TXbegin();
+        for (size_t i = 1; i <= 40; i += 3) {
+            l.remove(i, record_mgr);
+        }
+        tx->TXend<size_t, size_t>(record_mgr);
+        for (size_t i = 1; i <= 40; i++) {
+            EXPECT_EQ(l.get(i, record_mgr) == NULLOPT, i % 3 == 1);
+        }
+        EXPECT_EQ(tx->getAbortsAvoided(), 0);
+    });
+    t.join();
+}
+
+TEST(LinkedListTransction, readOnly) {
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        tx->TXbegin();
+        for (size_t i = 1; i <= 20; i++) {
+            l.put(i, i + 100, record_mgr);
+        }
+        tx->TXend<size_t, size_t>(record_mgr);
+
+        tx->TXbeginReadOnly();
+        for (size_t i = 1; i <= 20; i++) {
+            EXPECT_EQ(l.get(i, record_mgr), i + 100);
+        }
+        EXPECT_EQ(l.get(21, record_mgr), NULLOPT);
+        EXPECT_TRUE((tx->get_local_storge<size_t, size_t>().readSet.empty()));
+        EXPECT_THROW(l.put(3, 3, record_mgr), std::logic_error);
+        EXPECT_TRUE((tx->TXend<size_t, size_t>(record_mgr)));
+        EXPECT_EQ(l.get(3, record_mgr), 103);
+    });
+    t.join();
+}
+
+TEST(LinkedListTransction, rangeQuery) {
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        tx->TXbegin();
+        for (size_t i = 1; i <= 20; i++) {
+            l.put(i, i * 10, record_mgr);
+        }
+        tx->TXend<size_t, size_t>(record_mgr);
+
+        std::vector<std::pair<size_t, size_t>> out;
+        tx->TXbegin();
+        EXPECT_EQ(l.rangeQuery(5, 9, out, record_mgr), 5);
+        for (size_t i = 0; i < out.size(); i++) {
+            EXPECT_EQ(out[i].first, i + 5);
+            EXPECT_EQ(out[i].second, (i + 5) * 10);
+        }
+        // the transaction sees its own writes
+        l.put(7, 0, record_mgr);
+        l.remove(8, record_mgr);
+        l.put(100, 1, record_mgr);
+        EXPECT_EQ(l.rangeQuery(6, 9, out, record_mgr), 3);
+        EXPECT_EQ(out[1], (std::make_pair<size_t, size_t>(7, 0)));
+        EXPECT_EQ(out[2].first, 9);
+        EXPECT_EQ(l.rangeQuery(21, 99, out, record_mgr), 0);
+        EXPECT_TRUE((tx->TXend<size_t, size_t>(record_mgr)));
+
+        tx->TXbeginReadOnly();
+        EXPECT_EQ(l.rangeQuery(0, 1000, out, record_mgr), 20);
+        EXPECT_TRUE((tx->get_local_storge<size_t, size_t>().readSet.empty()));
+        EXPECT_TRUE((tx->TXend<size_t, size_t>(record_mgr)));
+
+        // singleton
+        EXPECT_EQ(l.rangeQuery(0, 1000, out, record_mgr), 20);
+        EXPECT_EQ(out.front().first, 1);
+        EXPECT_EQ(out.back(), (std::make_pair<size_t, size_t>(100, 1)));
+        EXPECT_EQ(l.rangeQuery(8, 8, out, record_mgr), 0);
+        l.deinit_list(record_mgr);
+    });
+    t.join();
+}
+
+TEST(LinkedListTransction, abortedInsertsReuseNodes) {
+    std::thread t([] {
+        using record_mgr_t = RecordMgr<size_t, size_t>;
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = record_mgr_t::make_record_mgr(1);
+        record_mgr_t record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        tx->TXbegin();
+        for (size_t i = 1; i <= 10; i++) {
+            l.put(i, i, record_mgr);
+        }
+        tx->handle_abort<size_t, size_t>(record_mgr);
+        EXPECT_EQ(record_mgr.spare_nodes(), 10);
+
+        // the retry allocates no list nodes
+        auto node_stats = global_record_mgr->getDebugInfo((record_mgr_t::node_t*) nullptr);
+        auto before = node_stats->getTotalFromPool();
+        tx->TXbegin();
+        for (size_t i = 1; i <= 10; i++) {
+            l.put(i, i * 10, record_mgr);
+        }
+        EXPECT_TRUE((tx->TXend<size_t, size_t>(record_mgr)));
+        EXPECT_EQ(node_stats->getTotalFromPool(), before);
+        EXPECT_EQ(record_mgr.spare_nodes(), 0);
+        for (size_t i = 1; i <= 10; i++) {
+            EXPECT_EQ(l.get(i, record_mgr), i * 10);
+        }
+        l.deinit_list(record_mgr);
+    });
+    t.join();
+}
+
+TEST(LinkedListTransction, commitAbortReusesNodes) {
+    std::thread t([] {
+        using record_mgr_t = RecordMgr<size_t, size_t>;
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = record_mgr_t::make_record_mgr(2);
+        record_mgr_t record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        l.put(0, 0, record_mgr);
+        tx->incrementAndGetVersion(); // else the singleton put aborts the first operation
+        tx->TXbegin();
+        for (size_t i = 1; i <= 10; i++) {
+            l.put(i, i, record_mgr);
+        }
+        // a singleton write of the node the inserts link behind, TXend fails validating it
+        std::thread([&] {
+            record_mgr_t writer_record_mgr(global_record_mgr, 1);
+            l.put(0, 100, writer_record_mgr);
+        }).join();
+        auto status = tx->tryCommit<size_t, size_t>(record_mgr);
+        EXPECT_FALSE(status);
+        EXPECT_EQ(status.site(), AbortSite::TX_END_READ_SET);
+        tx->handle_abort<size_t, size_t>(record_mgr);
+        EXPECT_EQ(record_mgr.spare_nodes(), 10);
+
+        // the retry allocates no list nodes
+        auto node_stats = global_record_mgr->getDebugInfo((record_mgr_t::node_t*) nullptr);
+        auto before = node_stats->getTotalFromPool();
+        tx->TXbegin();
+        for (size_t i = 1; i <= 10; i++) {
+            l.put(i, i * 10, record_mgr);
+        }
+        EXPECT_TRUE((tx->TXend<size_t, size_t>(record_mgr)));
+        EXPECT_EQ(node_stats->getTotalFromPool(), before);
+        EXPECT_EQ(record_mgr.spare_nodes(), 0);
+        for (size_t i = 1; i <= 10; i++) {
+            EXPECT_EQ(l.get(i, record_mgr), i * 10);
+        }
+        EXPECT_EQ(l.get(0, record_mgr), 100);
+        l.deinit_list(record_mgr);
+    });
+    t.join();
+}
+
+TEST(LinkedListTransction, commitAcrossKeyTypes) {
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_ids = RecordMgr<size_t, size_t>::make_record_mgr(1);
+        RecordMgr<size_t, size_t> ids_record_mgr(global_ids, 0);
+        auto global_names = RecordMgr<int, std::string>::make_record_mgr(2);
+        RecordMgr<int, std::string> names_record_mgr(global_names, 0);
+        LinkedList<size_t, size_t> ids(tx, ids_record_mgr);
+        LinkedList<int, std::string> names(tx, names_record_mgr);
+
+        // both lists commit together, with one clock increment
+        auto version = tx->getVersion();
+        tx->TXbegin();
+        ids.put(1, 10, ids_record_mgr);
+        names.put(10, "ten", names_record_mgr);
+        EXPECT_TRUE(tx->TXend());
+        EXPECT_EQ(tx->getVersion(), version + 1);
+        EXPECT_EQ(ids.get(1, ids_record_mgr), 10);
+        EXPECT_EQ(names.get(10, names_record_mgr), std::string("ten"));
+
+        // a conflict in one list drops the writes of both
+        tx->TXbegin();
+        ids.put(2, 20, ids_record_mgr);
+        names.put(20, "twenty", names_record_mgr);
+        names.remove(10, names_record_mgr);
+        std::thread([&] {
+            RecordMgr<int, std::string> writer_record_mgr(global_names, 1);
+            names.put(10, "TEN", writer_record_mgr);
+        }).join();
+        auto status = tx->tryCommit();
+        EXPECT_FALSE(status);
+        EXPECT_EQ(status.site(), AbortSite::TX_END_READ_SET);
+        tx->handle_abort();
+        EXPECT_EQ(ids.get(2, ids_record_mgr), NULLOPT);
+        EXPECT_EQ(names.get(20, names_record_mgr), NULLOPT);
+        EXPECT_EQ(names.get(10, names_record_mgr), std::string("TEN"));
+
+        // and TX::run retries the whole transaction
+        tx->run([&] {
+            ids.put(2, 20, ids_record_mgr);
+            names.put(20, "twenty", names_record_mgr);
+        }, RetryPolicy());
+        EXPECT_EQ(ids.get(2, ids_record_mgr), 20);
+        EXPECT_EQ(names.get(20, names_record_mgr), std::string("twenty"));
+        ids.deinit_list(ids_record_mgr);
+        names.deinit_list(names_record_mgr);
+    });
+    t.join();
+}
+
+TEST(LinkedListTransction, contextOps) {
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        auto global_names = RecordMgr<int, std::string>::make_record_mgr(1);
+        RecordMgr<int, std::string> names_record_mgr(global_names, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        LinkedList<int, std::string> names(tx, names_record_mgr);
+        auto& storage = tx->get_local_storge<size_t, size_t>();
+
+        auto& ctx = tx->TXbegin(record_mgr);
+        EXPECT_TRUE(storage.guardHeld);
+        EXPECT_EQ(ctx.readVersion, tx->getVersion());
+        for (size_t i = 1; i <= 10; i++) {
+            EXPECT_EQ(l.put(ctx, i, i * 10), NULLOPT);
+        }
+        EXPECT_EQ(l.get(ctx, 3), 30);
+        EXPECT_EQ(l.remove(ctx, 4), 40);
+        EXPECT_EQ(l.putIfAbsent(ctx, 5, 0), 50);
+        // the operations without a context join the same transaction
+        EXPECT_EQ(l.get(4, record_mgr), NULLOPT);
+        l.put(11, 110, record_mgr);
+        auto& names_ctx = tx->context(names_record_mgr);
+        names.put(names_ctx, 1, "one");
+        EXPECT_TRUE(tx->TXend());
+        EXPECT_FALSE(storage.guardHeld);
+
+        auto& read_ctx = tx->TXbeginReadOnly(record_mgr);
+        std::vector<std::pair<size_t, size_t>> out;
+        EXPECT_EQ(l.rangeQuery(read_ctx, 1, 100, out), 10);
+        EXPECT_TRUE(tx->TXend());
+        EXPECT_EQ(names.get(1, names_record_mgr), std::string("one"));
+
+        // an aborted transaction ends the guard too
+        auto& abort_ctx = tx->TXbegin(record_mgr);
+        l.put(abort_ctx, 12, 120);
+        tx->handle_abort();
+        EXPECT_FALSE(storage.guardHeld);
+        EXPECT_EQ(l.get(12, record_mgr), NULLOPT);
+        l.deinit_list(record_mgr);
+        names.deinit_list(names_record_mgr);
+    });
+    t.join();
+}
+
+// another configuration next to the default one, in the same binary
+struct Gv4EbrPolicy : DefaultTxPolicy {
+    using Clock = GV4Clock;
+    static constexpr CommitLockMode LOCK_MODE = CommitLockMode::SORTED_SPIN;
+    static constexpr bool ABORT_STATS = false;
+
+    template <typename key_t, typename val_t>
+    using record_mgr = RecordMgr<key_t, val_t, reclaimer_tree_ebr<key_t>>;
+};
+
+TEST(LinkedListTransction, policies) {
+    std::thread t([] {
+        using ebr_record_mgr_t = BasicTX<Gv4EbrPolicy>::record_mgr_t<size_t, size_t>;
+        auto tx = std::make_shared<BasicTX<Gv4EbrPolicy>>();
+        auto global_ebr = ebr_record_mgr_t::make_record_mgr(2);
+        ebr_record_mgr_t ebr_record_mgr(global_ebr, 0);
+        LinkedList<size_t, size_t, Gv4EbrPolicy> l(tx, ebr_record_mgr);
+        std::shared_ptr<TX> default_tx = std::make_shared<TX>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> default_l(default_tx, record_mgr);
+        EXPECT_EQ(tx->getCommitLockMode(), CommitLockMode::SORTED_SPIN);
+
+        // the transactions of the two policies run side by side, each with its own thread local state
+        tx->TXbegin();
+        default_tx->TXbegin();
+        l.put(1, 10, ebr_record_mgr);
+        default_l.put(1, 100, record_mgr);
+        EXPECT_TRUE(tx->TXend());
+        EXPECT_EQ(default_l.get(1, record_mgr), 100);
+        EXPECT_TRUE(default_tx->TXend());
+        EXPECT_EQ(l.get(1, ebr_record_mgr), 10);
+        EXPECT_EQ(default_l.get(1, record_mgr), 100);
+
+        // the policy doesn't count its aborts
+        auto before = AbortStats::localSnapshot();
+        tx->TXbegin();
+        l.put(2, 20, ebr_record_mgr);
+        l.get(1, ebr_record_mgr);
+        std::thread([&] {
+            ebr_record_mgr_t writer_record_mgr(global_ebr, 1);
+            l.put(1, 11, writer_record_mgr);
+        }).join();
+        EXPECT_FALSE(tx->tryCommit());
+        tx->handle_abort();
+        EXPECT_EQ((AbortStats::localSnapshot() - before).total(), 0);
+        EXPECT_EQ(l.get(2, ebr_record_mgr), NULLOPT);
+
+        tx->run([&] {
+            l.put(2, static_cast<size_t>(l.get(1, ebr_record_mgr)) + 1, ebr_record_mgr);
+        }, RetryPolicy());
+        EXPECT_EQ(l.get(2, ebr_record_mgr), 12);
+        l.deinit_list(ebr_record_mgr);
+        default_l.deinit_list(record_mgr);
+    });
+    t.join();
+}
+
+struct NoExtensionPolicy : DefaultTxPolicy {
+    static constexpr bool EXTEND_SNAPSHOT = false;
+};
+
+TEST(LinkedListTransction, snapshotExtension) {
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(2);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        for (size_t i = 1; i <= 100; i++) {
+            l.put(i, i, record_mgr);
+        }
+        auto write = [&](std::vector<size_t> keys) {
+            std::thread([&] {
+                RecordMgr<size_t, size_t> writer_record_mgr(global_record_mgr, 1);
+                tx->run([&] {
+                    for (auto k : keys) {
+                        l.put(k, k * 10, writer_record_mgr);
+                    }
+                }, RetryPolicy());
+            }).join();
+        };
+        write({100}); // the clock moves past the singleton puts
+
+        // a node written after the transaction started, nothing it read changed: it goes on and commits
+        tx->TXbegin();
+        EXPECT_EQ(l.get(1, record_mgr), 1);
+        write({50});
+        EXPECT_EQ(l.get(50, record_mgr), 500);
+        l.put(2, 20, record_mgr);
+        EXPECT_TRUE(tx->TXend(record_mgr));
+        EXPECT_EQ(tx->getExtensions(), 1);
+        EXPECT_EQ(tx->getExtendedCommits(), 1);
+
+        // a node it read changed too: the extension fails and the read aborts
+        tx->TXbegin();
+        EXPECT_EQ(l.get(1, record_mgr), 1);
+        write({1, 60});
+        Optional<size_t> ret;
+        auto status = l.tryGet(60, ret, record_mgr);
+        EXPECT_FALSE(status);
+        EXPECT_EQ(status.reason(), AbortReason::NEWER_VERSION);
+        tx->handle_abort<size_t, size_t>(record_mgr);
+        EXPECT_EQ(tx->getExtensions(), 1);
+        EXPECT_EQ(tx->getFailedExtensions(), 1);
+        EXPECT_EQ(tx->getExtendedCommits(), 1);
+
+        // a read only transaction logs nothing to validate again
+        tx->TXbeginReadOnly();
+        EXPECT_EQ(l.get(1, record_mgr), 10);
+        write({70});
+        EXPECT_FALSE(l.tryGet(70, ret, record_mgr));
+        tx->handle_abort<size_t, size_t>(record_mgr);
+        EXPECT_EQ(tx->getExtensions(), 1);
+        l.deinit_list(record_mgr);
+    });
+    t.join();
+
+    // and a policy without it aborts
+    std::thread([] {
+        auto tx = std::make_shared<BasicTX<NoExtensionPolicy>>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(2);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t, NoExtensionPolicy> l(tx, record_mgr);
+        l.put(1, 1, record_mgr);
+        l.put(2, 2, record_mgr);
+        tx->run([&] {
+            l.put(3, 3, record_mgr);
+        }, RetryPolicy(), record_mgr);
+        tx->TXbegin();
+        EXPECT_EQ(l.get(1, record_mgr), 1);
+        std::thread([&] {
+            RecordMgr<size_t, size_t> writer_record_mgr(global_record_mgr, 1);
+            tx->run([&] {
+                l.put(2, 20, writer_record_mgr);
+            }, RetryPolicy());
+        }).join();
+        Optional<size_t> ret;
+        EXPECT_FALSE(l.tryGet(2, ret, record_mgr));
+        tx->handle_abort<size_t, size_t>(record_mgr);
+        EXPECT_EQ(tx->getExtensions(), 0);
+        l.deinit_list(record_mgr);
+    }).join();
+}
+
+// a value that runs hook (once) when the marked value is copied, for a write of another thread in the middle
+// of an operation
+struct HookedVal {
+    size_t x = 0;
+    static std::function<void()> hook;
+    static size_t marked;
+
+    HookedVal() = default;
+    HookedVal(const HookedVal& other) = default;
+
+    HookedVal& operator=(const HookedVal& other) {
+        x = other.x;
+        if (hook && x == marked) {
+            auto h = std::move(hook);
+            hook = nullptr;
+            h();
+        }
+        return *this;
+    }
+
+    bool operator==(const HookedVal& other) const {
+        return x == other.x;
+    }
+
+    friend std::ostream& operator<<(std::ostream& stream, const HookedVal& v) {
+        return stream << v.x;
+    }
+};
+
+std::function<void()> HookedVal::hook;
+size_t HookedVal::marked = 0;
+
+// an extension in the middle of an operation starts it over, the pred and next it found may be stale
+TEST(LinkedListTransction, extensionRestartsTheOperation) {
+    std::thread([] {
+        using list_t = LinkedList<size_t, HookedVal>;
+        using record_mgr_t = list_t::record_mgr_t;
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = record_mgr_t::make_record_mgr(2);
+        record_mgr_t record_mgr(global_record_mgr, 0);
+        list_t l(tx, record_mgr);
+        l.put(5, HookedVal{5}, record_mgr);
+        l.put(10, HookedVal{10}, record_mgr);
+        tx->incrementAndGetVersion(); // else the singleton puts abort the transaction
+        auto extensions = tx->getExtensions();
+
+        // put(7) found pred 5 and next 10, 6 is linked after 5 while it reads the value of 5
+        tx->TXbegin();
+        HookedVal::marked = 5;
+        HookedVal::hook = [&] {
+            std::thread([&] {
+                record_mgr_t writer_record_mgr(global_record_mgr, 1);
+                tx->run([&] {
+                    l.put(6, HookedVal{6}, writer_record_mgr);
+                }, RetryPolicy());
+            }).join();
+        };
+        l.put(7, HookedVal{7}, record_mgr);
+        EXPECT_TRUE(tx->TXend(record_mgr));
+        EXPECT_EQ(tx->getExtensions(), extensions + 1);
+        std::vector<std::pair<size_t, HookedVal>> out;
+        EXPECT_EQ(l.rangeQuery(0, 100, out, record_mgr), 4);
+        EXPECT_EQ(l.get(6, record_mgr), HookedVal{6});
+
+        // remove(10) found pred 7, 8 is linked after 7 while it reads the value of 7
+        tx->TXbegin();
+        HookedVal::marked = 7;
+        HookedVal::hook = [&] {
+            std::thread([&] {
+                record_mgr_t writer_record_mgr(global_record_mgr, 1);
+                tx->run([&] {
+                    l.put(8, HookedVal{8}, writer_record_mgr);
+                }, RetryPolicy());
+            }).join();
+        };
+        EXPECT_EQ(l.remove(10, record_mgr), HookedVal{10});
+        EXPECT_TRUE(tx->TXend(record_mgr));
+        EXPECT_EQ(tx->getExtensions(), extensions + 2);
+        EXPECT_EQ(l.rangeQuery(0, 100, out, record_mgr), 4);
+        EXPECT_EQ(l.get(8, record_mgr), HookedVal{8});
+        EXPECT_EQ(l.get(10, record_mgr), NULLOPT);
+        l.deinit_list(record_mgr);
+    }).join();
+}
+
+struct MultiVersionPolicy : DefaultTxPolicy {
+    static constexpr bool MULTI_VERSION = true;
+};
+
+TEST(LinkedListTransction, multiVersion) {
+    std::thread([] {
+        using mv_tx_t = BasicTX<MultiVersionPolicy>;
+        using list_t = LinkedList<size_t, size_t, MultiVersionPolicy>;
+        using record_mgr_t = list_t::record_mgr_t;
+        auto tx = std::make_shared<mv_tx_t>();
+        auto global_record_mgr = record_mgr_t::make_record_mgr(2);
+        record_mgr_t record_mgr(global_record_mgr, 0);
+        list_t l(tx, record_mgr);
+        for (size_t i = 1; i <= 100; i++) {
+            l.put(i, i, record_mgr);
+        }
+        auto write = [&](std::function<void(const record_mgr_t&)> op) {
+            std::thread([&] {
+                record_mgr_t writer_record_mgr(global_record_mgr, 1);
+                op(writer_record_mgr);
+            }).join();
+        };
+
+        // the snapshot doesn't see the transactions and singleton writes that come after it, and doesn't abort
+        auto& ctx = tx->TXbeginReadOnly(record_mgr);
+        EXPECT_EQ(l.get(ctx, 1), 1);
+        write([&](const record_mgr_t& rm) {
+            tx->run([&] {
+                l.put(1, 10, rm);
+                l.remove(50, rm);
+                l.put(1000, 1000, rm);
+            }, RetryPolicy());
+            l.put(2, 20, rm);
+            l.remove(60, rm);
+            l.put(150, 150, rm);
+        });
+        EXPECT_EQ(l.get(ctx, 1), 1);
+        EXPECT_EQ(l.get(ctx, 2), 2);
+        EXPECT_EQ(l.get(ctx, 50), 50);
+        EXPECT_EQ(l.get(ctx, 60), 60);
+        EXPECT_EQ(l.get(ctx, 150), NULLOPT);
+        EXPECT_EQ(l.get(ctx, 1000), NULLOPT);
+        std::vector<std::pair<size_t, size_t>> out;
+        EXPECT_EQ(l.rangeQuery(ctx, 45, 1000, out), 56);
+        for (auto& kv : out) {
+            EXPECT_EQ(kv.first, kv.second);
+        }
+        EXPECT_TRUE(tx->TXend(record_mgr));
+
+        // the next one does
+        auto& next_ctx = tx->TXbeginReadOnly(record_mgr);
+        EXPECT_EQ(l.get(next_ctx, 1), 10);
+        EXPECT_EQ(l.get(next_ctx, 2), 20);
+        EXPECT_EQ(l.get(next_ctx, 50), NULLOPT);
+        EXPECT_EQ(l.get(next_ctx, 60), NULLOPT);
+        EXPECT_EQ(l.get(next_ctx, 150), 150);
+        EXPECT_EQ(l.rangeQuery(next_ctx, 45, 1000, out), 56);
+        EXPECT_TRUE(tx->TXend(record_mgr));
+
+        // snapshots of a sum that concurrent transfers keep the same
+        std::atomic<bool> done(false);
+        std::thread writer([&] {
+            record_mgr_t writer_record_mgr(global_record_mgr, 1);
+            for (size_t i = 0; i < 2000; i++) {
+                size_t from = 1 + i % 100;
+                size_t to = 1 + (i * 7) % 100;
+                tx->run([&] {
+                    auto from_val = l.get(from, writer_record_mgr);
+                    auto to_val = l.get(to, writer_record_mgr);
+                    if (from_val && to_val && from != to) {
+                        l.remove(from, writer_record_mgr);
+                        l.put(from, static_cast<size_t>(from_val) - 1, writer_record_mgr);
+                        l.put(to, static_cast<size_t>(to_val) + 1, writer_record_mgr);
+                    }
+                }, RetryPolicy(), writer_record_mgr);
+            }
+            done = true;
+        });
+        size_t expected = 0;
+        l.rangeQuery(0, 1000, out, record_mgr);
+        for (auto& kv : out) {
+            expected += kv.second;
+        }
+        auto aborts = AbortStats::localSnapshot();
+        do {
+            tx->TXbeginReadOnly(record_mgr);
+            l.rangeQuery(0, 1000, out, record_mgr);
+            size_t sum = 0;
+            for (auto& kv : out) {
+                sum += kv.second;
+            }
+            EXPECT_EQ(sum, expected);
+            EXPECT_TRUE(tx->TXend(record_mgr));
+        } while (!done);
+        writer.join();
+        EXPECT_EQ((AbortStats::localSnapshot() - aborts).total(), 0);
+        l.deinit_list(record_mgr);
+    }).join();
+}
+
+// only the nodes of a multi version policy carry the chain of older versions
+static_assert(std::is_same<LinkedList<size_t, size_t>::record_mgr_t::node_t, LNode<size_t, size_t>>::value,
+              "single version lists have plain nodes");
+static_assert(std::is_same<LinkedList<size_t, size_t, MultiVersionPolicy>::record_mgr_t::node_t,
+                           VersionedLNode<size_t, size_t>>::value, "multi version lists have versioned nodes");
+
+TEST(SnapshotRegistry, countsRunningSnapshots) {
+    SnapshotRegistry snapshots(true);
+    EXPECT_FALSE(snapshots.running());
+    EXPECT_EQ(snapshots.oldest(100), 100);
+    // a snapshot announces twice: the lower bound, then its read version
+    snapshots.enter(3, 40);
+    snapshots.enter(3, 50);
+    snapshots.enter(7, 60);
+    EXPECT_TRUE(snapshots.running());
+    EXPECT_EQ(snapshots.oldest(100), 50);
+    snapshots.exit(3);
+    EXPECT_TRUE(snapshots.running());
+    EXPECT_EQ(snapshots.oldest(100), 60);
+    snapshots.exit(7);
+    snapshots.exit(7);
+    EXPECT_FALSE(snapshots.running());
+    EXPECT_EQ(snapshots.oldest(100), 100);
+}
+
+// the unlinked nodes a snapshot could still reach are kept by the list, not by the thread that unlinked them
+TEST(LinkedListTransction, multiVersionUnlinkedNodesAreRetired) {
+    using list_t = LinkedList<size_t, size_t, MultiVersionPolicy>;
+    using record_mgr_t = list_t::record_mgr_t;
+    if (!record_mgr_t::STATS) {
+        GTEST_SKIP() << "build with RECORD_MGR_STATS";
+    }
+    std::thread([] {
+        auto tx = std::make_shared<BasicTX<MultiVersionPolicy>>();
+        auto global_record_mgr = record_mgr_t::make_record_mgr(2);
+        record_mgr_t record_mgr(global_record_mgr, 0);
+        list_t l(tx, record_mgr);
+        for (size_t i = 1; i <= 10; i++) {
+            l.put(i, i, record_mgr);
+        }
+        auto& ctx = tx->TXbeginReadOnly(record_mgr);
+        std::thread([&] {
+            record_mgr_t writer_record_mgr(global_record_mgr, 1);
+            for (size_t i = 1; i <= 10; i++) {
+                l.remove(i, writer_record_mgr);
+            }
+        }).join();
+        EXPECT_EQ(l.get(ctx, 5), 5);
+        EXPECT_TRUE(tx->TXend(record_mgr));
+        l.deinit_list(record_mgr);
+        // every list node that was allocated (only the DEBRA build allocates them from the record manager) is retired
+        auto debugInfo = global_record_mgr->getDebugInfo((record_mgr_t::node_t*) nullptr);
+        EXPECT_EQ(debugInfo->getTotalRetired(), debugInfo->getTotalFromPool());
+    }).join();
+}
+
+// a snapshot only reads the clock, a singleton write that runs during it is still newer than it
+TEST(LinkedListTransction, multiVersionSnapshotDoesntWriteTheClock) {
+    std::thread([] {
+        using list_t = LinkedList<size_t, size_t, MultiVersionPolicy>;
+        using record_mgr_t = list_t::record_mgr_t;
+        auto tx = std::make_shared<BasicTX<MultiVersionPolicy>>();
+        auto global_record_mgr = record_mgr_t::make_record_mgr(2);
+        record_mgr_t record_mgr(global_record_mgr, 0);
+        list_t l(tx, record_mgr);
+        l.put(1, 1, record_mgr);
+        auto version = tx->getVersion();
+        auto& ctx = tx->TXbeginReadOnly(record_mgr);
+        EXPECT_EQ(tx->getVersion(), version);
+        EXPECT_EQ(ctx.readVersion, version);
+        std::thread([&] {
+            record_mgr_t writer_record_mgr(global_record_mgr, 1);
+            l.put(1, 10, writer_record_mgr);
+            l.put(2, 20, writer_record_mgr);
+        }).join();
+        EXPECT_EQ(l.get(ctx, 1), 1);
+        EXPECT_EQ(l.get(ctx, 2), NULLOPT);
+        EXPECT_TRUE(tx->TXend(record_mgr));
+        // no snapshot runs, the singleton writes don't write the clock either
+        version = tx->getVersion();
+        l.put(1, 100, record_mgr);
+        EXPECT_EQ(tx->getVersion(), version);
+        auto& next_ctx = tx->TXbeginReadOnly(record_mgr);
+        EXPECT_EQ(l.get(next_ctx, 1), 100);
+        EXPECT_EQ(l.get(next_ctx, 2), 20);
+        EXPECT_TRUE(tx->TXend(record_mgr));
+        l.deinit_list(record_mgr);
+    }).join();
+}
@@ -1,4 +1,6 @@
 #include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
 #include <thread>
 #include "../datatypes/LinkedList.h"
 
@@ -115,4 +117,387 @@ TEST(LinkedListTransctionMT, SingeltonPutBeforeTx) {
                         });
     //now there will be a commit
     t1.run_thread_set_2();
-}
\ No newline at end of file
+}
+TEST(LinkedListTransctionMT, readOnlyAbortsOnNewerVersion) {
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(2);
+    RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+    RecordMgr<size_t, size_t> record_mgr2(global_record_mgr, 1);
+    LinkedList<size_t, size_t> l(tx, record_mgr);
+    // the writers run on fresh threads, the tests above leave this thread's transaction open
+    auto tx_put = [&l, tx, &record_mgr](size_t key, size_t val) {
+        std::thread([&l, tx, &record_mgr, key, val] {
+            tx->TXbegin();
+            l.put(key, val, record_mgr);
+            tx->TXend<size_t, size_t>(record_mgr);
+        }).join();
+    };
+    tx_put(5, 3);
+    ThreadRunner t1;
+    t1.run_thread_set_1([&l, tx, &record_mgr2] {
+                            tx->TXbeginReadOnly();
+                            EXPECT_EQ(l.get(5, record_mgr2), 3);
+                        },
+                        [&l, tx, &record_mgr2] {
+                            // 5 was rewritten after this transaction started
+                            ASSERT_THROW(l.get(5, record_mgr2), TxAbortException);
+                            tx->handle_abort<size_t, size_t>(record_mgr2);
+                        });
+    tx_put(5, 4);
+    t1.run_thread_set_2();
+}
+
+TEST(LinkedListTransctionMT, rangeQuerySeesConsistentTransfers) {
+    const size_t n_keys = 16;
+    const size_t n_writers = 2;
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(n_writers + 2);
+    std::unique_ptr<LinkedList<size_t, size_t>> l;
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        l = std::make_unique<LinkedList<size_t, size_t>>(tx, record_mgr);
+        tx->TXbegin();
+        for (size_t i = 1; i <= n_keys; i++) {
+            l->put(i, 100, record_mgr);
+        }
+        tx->TXend<size_t, size_t>(record_mgr);
+    }).join();
+
+    // writers move one unit between two keys, the sum over all keys never changes
+    std::atomic<bool> done(false);
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < n_writers; w++) {
+        threads.emplace_back([&, w] {
+            RecordMgr<size_t, size_t> record_mgr(global_record_mgr, w + 1);
+            for (size_t i = 0; i < 300; i++) {
+                size_t from = (i * 7 + w) % n_keys + 1;
+                size_t to = (i * 5 + w + 3) % n_keys + 1;
+                if (from == to) continue;
+                try {
+                    tx->TXbegin();
+                    size_t from_val = l->get(from, record_mgr);
+                    size_t to_val = l->get(to, record_mgr);
+                    l->put(from, from_val - 1, record_mgr);
+                    l->put(to, to_val + 1, record_mgr);
+                    tx->TXend<size_t, size_t>(record_mgr);
+                } catch (TxAbortException&) {
+                    tx->handle_abort<size_t, size_t>(record_mgr);
+                }
+            }
+        });
+    }
+    threads.emplace_back([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, n_writers + 1);
+        std::vector<std::pair<size_t, size_t>> out;
+        while (!done) {
+            // singleton
+            EXPECT_EQ(l->rangeQuery(1, n_keys, out, record_mgr), n_keys);
+            size_t sum = 0;
+            for (auto& kv : out) sum += kv.second;
+            EXPECT_EQ(sum, n_keys * 100);
+            // read only transaction
+            try {
+                tx->TXbeginReadOnly();
+                l->rangeQuery(1, n_keys, out, record_mgr);
+                tx->TXend<size_t, size_t>(record_mgr);
+                sum = 0;
+                for (auto& kv : out) sum += kv.second;
+                EXPECT_EQ(sum, n_keys * 100);
+            } catch (TxAbortException&) {
+                tx->handle_abort<size_t, size_t>(record_mgr);
+            }
+        }
+    });
+    for (size_t w = 0; w < n_writers; w++) {
+        threads[w].join();
+    }
+    done = true;
+    threads.back().join();
+}
+
+TEST(LinkedListTransctionMT, abortReasons) {
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(2);
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        tx->TXbegin();
+        l.put(5, 3, record_mgr);
+        tx->TXend<size_t, size_t>(record_mgr);
+        tx->TXbegin();
+        EXPECT_EQ(l.get(5, record_mgr), 3);
+        l.put(6, 6, record_mgr);
+        // 5 is rewritten (by a transaction, which moves the clock on) after this transaction read it
+        std::thread([&] {
+            RecordMgr<size_t, size_t> record_mgr2(global_record_mgr, 1);
+            tx->TXbegin();
+            l.put(5, 4, record_mgr2);
+            tx->TXend<size_t, size_t>(record_mgr2);
+        }).join();
+        try {
+            tx->TXend<size_t, size_t>(record_mgr);
+            ADD_FAILURE() << "committed over a newer version";
+        } catch (TxAbortException& e) {
+            EXPECT_EQ(e.reason(), AbortReason::NEWER_VERSION);
+        }
+        tx->handle_abort<size_t, size_t>(record_mgr);
+        l.deinit_list(record_mgr);
+    }).join();
+}
+
+TEST(LinkedListTransctionMT, runRetriesUntilCommit) {
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        RetryPolicy policy(RetryPolicy::Backoff::EXPONENTIAL, 0);
+        int attempts = 0;
+        size_t ret = tx->run([&] {
+            l.put(attempts + 1, 1, record_mgr);
+            if (++attempts < 3) {
+                throw TxAbortException();
+            }
+            return size_t(7);
+        }, policy, record_mgr);
+        EXPECT_EQ(ret, 7);
+        EXPECT_EQ(tx->lastRunStats().attempts, 3);
+        EXPECT_EQ(tx->lastRunStats().aborts[static_cast<size_t>(AbortReason::EXPLICIT)], 2);
+        EXPECT_FALSE(tx->lastRunStats().irrevocable);
+        EXPECT_EQ(tx->getRunAborts(AbortReason::EXPLICIT), 2);
+        // only the committed attempt is visible
+        EXPECT_EQ(l.get_size(), 1);
+        EXPECT_EQ(l.get(3, record_mgr), 1);
+
+        // the second attempt runs irrevocably
+        attempts = 0;
+        tx->run([&] {
+            if (++attempts == 1) {
+                throw TxAbortException();
+            }
+            l.remove(3, record_mgr);
+        }, RetryPolicy(RetryPolicy::Backoff::KARMA, 1), record_mgr);
+        EXPECT_EQ(tx->lastRunStats().attempts, 2);
+        EXPECT_TRUE(tx->lastRunStats().irrevocable);
+        EXPECT_EQ(tx->getIrrevocableRuns(), 1);
+        EXPECT_EQ(l.get_size(), 0);
+
+        // other exceptions abort the transaction and aren't retried
+        EXPECT_THROW(tx->run([&] {
+            l.put(8, 8, record_mgr);
+            throw std::runtime_error("op failed");
+        }, policy, record_mgr), std::runtime_error);
+        EXPECT_EQ(tx->lastRunStats().attempts, 1);
+        EXPECT_EQ(l.get(8, record_mgr), NULLOPT);
+        l.deinit_list(record_mgr);
+    }).join();
+}
+
+TEST(LinkedListTransctionMT, runTransfersKeepSum) {
+    const size_t n_keys = 8;
+    const size_t n_writers = 3;
+    const size_t n_transfers = 200;
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(n_writers + 1);
+    std::unique_ptr<LinkedList<size_t, size_t>> l;
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        l = std::make_unique<LinkedList<size_t, size_t>>(tx, record_mgr);
+        for (size_t i = 1; i <= n_keys; i++) {
+            l->put(i, 1000, record_mgr);
+        }
+    }).join();
+
+    // every writer uses another backoff, some transactions go irrevocable, none is dropped
+    const RetryPolicy::Backoff backoffs[] = {RetryPolicy::Backoff::EXPONENTIAL, RetryPolicy::Backoff::RANDOMIZED,
+                                             RetryPolicy::Backoff::KARMA};
+    auto transfer = [n_keys](size_t w, size_t i) {
+        // keys 1 and 2 are moved to by everyone, the rest spread out
+        size_t from = (i * 5 + w) % n_keys + 1;
+        size_t to = i % 2 + 1;
+        return std::make_pair(from == to ? n_keys : from, to);
+    };
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < n_writers; w++) {
+        threads.emplace_back([&, w] {
+            RecordMgr<size_t, size_t> record_mgr(global_record_mgr, w + 1);
+            RetryPolicy policy(backoffs[w], 4);
+            for (size_t i = 0; i < n_transfers; i++) {
+                size_t from, to;
+                std::tie(from, to) = transfer(w, i);
+                tx->run([&] {
+                    size_t from_val = l->get(from, record_mgr);
+                    size_t to_val = l->get(to, record_mgr);
+                    l->put(from, from_val - 1, record_mgr);
+                    l->put(to, to_val + 1, record_mgr);
+                }, policy, record_mgr);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    // all transfers committed, whatever the order
+    std::vector<size_t> expected(n_keys + 1, 1000);
+    for (size_t w = 0; w < n_writers; w++) {
+        for (size_t i = 0; i < n_transfers; i++) {
+            auto ft = transfer(w, i);
+            expected[ft.first]--;
+            expected[ft.second]++;
+        }
+    }
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        for (size_t i = 1; i <= n_keys; i++) {
+            EXPECT_EQ(l->get(i, record_mgr), expected[i]);
+        }
+        l->deinit_list(record_mgr);
+    }).join();
+}
+
+// the irrevocable token only keeps the other TX::run attempts out: a singleton write and a transaction begun by
+// hand still commit, and the irrevocable attempts they abort are retried, still irrevocably
+TEST(LinkedListTransctionMT, irrevocableOnlyExcludesRuns) {
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(4);
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        l.put(1, 1, record_mgr);
+        l.put(2, 2, record_mgr);
+        tx->incrementAndGetVersion(); // else the singleton puts abort the first transaction
+        std::atomic<bool> run_done(false);
+        std::thread run_thread;
+        int attempts = 0;
+        tx->run([&] {
+            if (++attempts == 1) {
+                throw TxAbortException();
+            }
+            l.put(3, attempts, record_mgr);
+            if (attempts == 2) {
+                l.get(1, record_mgr);
+                run_thread = std::thread([&] {
+                    RecordMgr<size_t, size_t> run_record_mgr(global_record_mgr, 1);
+                    tx->run([&] {
+                        l.put(1, 10, run_record_mgr);
+                    }, RetryPolicy(), run_record_mgr);
+                    run_done = true;
+                });
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                EXPECT_FALSE(run_done); // waits for the token
+                std::thread([&] {
+                    RecordMgr<size_t, size_t> singleton_record_mgr(global_record_mgr, 2);
+                    l.put(1, 100, singleton_record_mgr);
+                }).join();
+            } else if (attempts == 3) {
+                l.get(2, record_mgr);
+                std::thread([&] {
+                    RecordMgr<size_t, size_t> tx_record_mgr(global_record_mgr, 3);
+                    tx->TXbegin();
+                    l.put(2, 20, tx_record_mgr);
+                    tx->TXend<size_t, size_t>(tx_record_mgr);
+                }).join();
+            }
+        }, RetryPolicy(RetryPolicy::Backoff::KARMA, 1), record_mgr);
+        EXPECT_EQ(tx->lastRunStats().attempts, 4);
+        EXPECT_TRUE(tx->lastRunStats().irrevocable);
+        EXPECT_EQ(l.get(3, record_mgr), 4);
+        EXPECT_EQ(l.get(2, record_mgr), 20);
+        run_thread.join();
+        EXPECT_TRUE(run_done);
+        EXPECT_EQ(l.get(1, record_mgr), 10); // the other run committed after the irrevocable one
+        l.deinit_list(record_mgr);
+    }).join();
+}
+
+TEST(LinkedListTransctionMT, abortStatsCountSites) {
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(2);
+    auto before = AbortStats::snapshot();
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        tx->TXbegin();
+        l.put(5, 3, record_mgr);
+        tx->TXend<size_t, size_t>(record_mgr);
+        // 5 is locked by a committing transaction while another transaction walks to it
+        l.head->m_next->tryLock(OwnerIds::MAX_ID);
+        std::thread([&] {
+            RecordMgr<size_t, size_t> record_mgr2(global_record_mgr, 1);
+            tx->TXbegin();
+            try {
+                l.get(5, record_mgr2);
+                ADD_FAILURE() << "read a locked node";
+            } catch (TxAbortException& e) {
+                EXPECT_NE(e.site(), AbortSite::USER);
+                EXPECT_EQ(e.reason(), AbortReason::LOCKED);
+                tx->handle_abort<size_t, size_t>(record_mgr2);
+            }
+            // TXend of an aborted transaction
+            EXPECT_THROW((tx->TXend<size_t, size_t>(record_mgr2)), TxAbortException);
+            EXPECT_EQ(AbortStats::localSnapshot().total(), AbortStats::ENABLED ? 2 : 0);
+        }).join();
+        l.head->m_next->unlock();
+        tx->run([&] {
+            static bool first = true;
+            if (first) {
+                first = false;
+                throw TxAbortException();
+            }
+        }, RetryPolicy(RetryPolicy::Backoff::IMMEDIATE), record_mgr);
+        l.deinit_list(record_mgr);
+    }).join();
+
+    auto aborts = AbortStats::snapshot() - before;
+    if (!AbortStats::ENABLED) {
+        EXPECT_EQ(aborts.total(), 0);
+        return;
+    }
+    EXPECT_EQ(aborts.total(), 3);
+    EXPECT_EQ(aborts.byReason(AbortReason::LOCKED), 1);
+    EXPECT_EQ(aborts.get(AbortSite::TX_END_NOT_ACTIVE, AbortReason::NOT_ACTIVE), 1);
+    EXPECT_EQ(aborts.get(AbortSite::USER, AbortReason::EXPLICIT), 1);
+}
+
+TEST(LinkedListTransctionMT, tryOpsReturnAborts) {
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+    std::thread([&] {
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        Optional<size_t> ret;
+        tx->TXbegin();
+        EXPECT_TRUE(l.tryPut(5, 3, ret, record_mgr));
+        EXPECT_EQ(ret, NULLOPT);
+        EXPECT_TRUE(l.tryPut(7, 4, ret, record_mgr));
+        EXPECT_TRUE(l.tryGet(5, ret, record_mgr));
+        EXPECT_EQ(ret, 3);
+        EXPECT_TRUE(tx->tryCommit(record_mgr));
+
+        // 5 is locked by a committing transaction
+        l.head->m_next->tryLock(OwnerIds::MAX_ID);
+        tx->TXbegin();
+        EXPECT_TRUE(l.tryPut(9, 9, ret, record_mgr));
+        auto status = l.tryGet(7, ret, record_mgr);
+        EXPECT_FALSE(status);
+        EXPECT_EQ(status.reason(), AbortReason::LOCKED);
+        EXPECT_NE(status.site(), AbortSite::USER);
+        status = tx->tryCommit(record_mgr);
+        EXPECT_FALSE(status);
+        EXPECT_EQ(status.site(), AbortSite::TX_END_NOT_ACTIVE);
+        tx->handle_abort<size_t, size_t>(record_mgr);
+        l.head->m_next->unlock();
+        EXPECT_EQ(l.get(9, record_mgr), NULLOPT);
+
+        tx->TXbegin();
+        EXPECT_TRUE(l.tryRemove(5, ret, record_mgr));
+        EXPECT_EQ(ret, 3);
+        EXPECT_TRUE(l.tryRemove(6, ret, record_mgr));
+        EXPECT_EQ(ret, NULLOPT);
+        EXPECT_TRUE(tx->tryCommit(record_mgr));
+        EXPECT_EQ(l.get(5, record_mgr), NULLOPT);
+        EXPECT_EQ(l.get(7, record_mgr), 4);
+        l.deinit_list(record_mgr);
+    }).join();
+}
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+#include <type_traits>
+#include "../nodes/LNodeWrapper.h"
+
+TEST(LNodeMask, lockOwner) {
+    using lnode_t = LNode<size_t, size_t>;
+    lnode_t n(5);
+    ASSERT_TRUE(n.tryLock(3));
+    EXPECT_FALSE(n.tryLock(4));
+    n.setVersion(17);
+    auto l = n.getVersionMask();
+    EXPECT_EQ(lnode_t::versionOf(l), 17);
+    EXPECT_FALSE(lnode_t::isLockedByOther(l, 3));
+    EXPECT_TRUE(lnode_t::isLockedByOther(l, 4));
+    EXPECT_TRUE(lnode_t::isLockedByOther(l, 0));
+    n.unlock();
+    l = n.getVersionMask();
+    EXPECT_FALSE(lnode_t::isLockedByOther(l, 4));
+    EXPECT_EQ(n.getVersion(), 17);
+
+    // singleton locks have no owner
+    ASSERT_TRUE(n.tryLock());
+    EXPECT_TRUE(lnode_t::isLockedByOther(n.getVersionMask(), 3));
+    n.unlock();
+}
+
+TEST(LNodeLayout, hotFieldsFirst) {
+    using lnode_t = LNode<size_t, size_t>;
+    lnode_t n(5);
+    auto base = reinterpret_cast<const char*>(&n);
+    auto key = reinterpret_cast<const char*>(&n.m_key);
+    auto next = reinterpret_cast<const char*>(&n.m_next);
+    auto val = reinterpret_cast<const char*>(&n.m_val);
+    EXPECT_LT(key, next);
+    EXPECT_LT(next, val);
+    EXPECT_LE(next + sizeof(n.m_next) - base, lnode_t::HOT_SIZE);
+    if (lnode_t::COMPACT) {
+        EXPECT_EQ(alignof(lnode_t), CACHE_LINE_SIZE);
+        EXPECT_EQ(sizeof(lnode_t), CACHE_LINE_SIZE);
+    }
+
+    // a value too big for the line of the hot fields starts on the next line
+    struct big_val_t { char data[64]; };
+    using big_lnode_t = LNode<size_t, big_val_t>;
+    EXPECT_EQ(big_lnode_t::INLINE_VAL, !big_lnode_t::COMPACT);
+}
+
+#if defined(UNSAFE) || defined(DEBRA)
+static_assert(std::is_trivially_copyable<LNodeWrapper<size_t, size_t>>::value, "node handles are plain pointers");
+static_assert(sizeof(LNodeWrapper<size_t, size_t>) == sizeof(void*), "node handles are plain pointers");
+#endif
+
+TEST(LNodeWrapper, deletedIsTheNodeBit) {
+#if defined(DEBRA)
+    LNode<size_t, size_t> n(5);
+    LNodeWrapper<size_t, size_t> w(&n);
+#else
+    LNodeWrapper<size_t, size_t> w(5);
+#endif
+    auto copy = w;
+    EXPECT_FALSE(copy.is_deleted());
+    ASSERT_TRUE(w->tryLock());
+    w->setDeleted(true);
+    w->unlock();
+    EXPECT_TRUE(copy.is_deleted());
+}
@@ -1,7 +1,276 @@
 #include <gtest/gtest.h>
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <vector>
 #include "../datatypes/Queue.h"
+#include "../datatypes/LinkedList.h"
 #include "../nodes/QNode.h"
 
 TEST(Queue, helloWorld) {
     QNode<size_t> q(5);
-}
\ No newline at end of file
+}
+
+// a fresh thread, the tests before leave the main thread's transaction open and the enqueues would join it
+TEST(QueueSingleton, fifo) {
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        Queue<size_t> q(tx, record_mgr);
+        EXPECT_TRUE(q.isEmpty(record_mgr));
+        for (size_t i = 0; i < 10; i++) {
+            q.enqueue(i, record_mgr);
+        }
+        EXPECT_FALSE(q.isEmpty(record_mgr));
+        EXPECT_EQ(q.get_size(), 10);
+        for (size_t i = 0; i < 10; i++) {
+            EXPECT_EQ(q.dequeue(record_mgr), i);
+        }
+        EXPECT_TRUE(q.isEmpty(record_mgr));
+        EXPECT_THROW(q.dequeue(record_mgr), EmptyQueueException);
+        q.deinit_queue(record_mgr);
+    });
+    t.join();
+}
+
+// the transactions run in a fresh thread, the tests before leave the main thread's transaction open
+TEST(QueueTransaction, enqueueCommit) {
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        Queue<size_t> q(tx, record_mgr);
+        q.enqueue(1, record_mgr);
+        tx->incrementAndGetVersion(); // else the singleton enqueue aborts the first transaction
+        tx->TXbegin();
+        q.enqueue(2, record_mgr);
+        q.enqueue(3, record_mgr);
+        EXPECT_EQ(q.get_size(), 1); // nothing is visible before commit
+        tx->TXend<size_t, size_t>(record_mgr);
+        EXPECT_EQ(q.get_size(), 3);
+        EXPECT_FALSE(q.isLocked());
+        for (size_t i = 1; i <= 3; i++) {
+            EXPECT_EQ(q.dequeue(record_mgr), i);
+        }
+        EXPECT_TRUE(q.isEmpty(record_mgr));
+        q.deinit_queue(record_mgr);
+    });
+    t.join();
+}
+
+TEST(QueueTransaction, dequeueSharedThenLocal) {
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        Queue<size_t> q(tx, record_mgr);
+        q.enqueue(1, record_mgr);
+        q.enqueue(2, record_mgr);
+        tx->incrementAndGetVersion();
+        tx->TXbegin();
+        q.enqueue(3, record_mgr);
+        EXPECT_EQ(q.dequeue(record_mgr), 1);
+        EXPECT_TRUE(q.isLocked());
+        EXPECT_EQ(q.dequeue(record_mgr), 2);
+        EXPECT_FALSE(q.isEmpty(record_mgr));
+        EXPECT_EQ(q.dequeue(record_mgr), 3);
+        EXPECT_TRUE(q.isEmpty(record_mgr));
+        EXPECT_THROW(q.dequeue(record_mgr), EmptyQueueException);
+        q.enqueue(4, record_mgr);
+        tx->TXend<size_t, size_t>(record_mgr);
+        EXPECT_FALSE(q.isLocked());
+        EXPECT_EQ(q.get_size(), 1);
+        EXPECT_EQ(q.dequeue(record_mgr), 4);
+        EXPECT_TRUE(q.isEmpty(record_mgr));
+        q.deinit_queue(record_mgr);
+    });
+    t.join();
+}
+
+TEST(QueueTransaction, abortDiscards) {
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        Queue<size_t> q(tx, record_mgr);
+        q.enqueue(1, record_mgr);
+        tx->incrementAndGetVersion();
+        tx->TXbegin();
+        EXPECT_EQ(q.dequeue(record_mgr), 1);
+        q.enqueue(2, record_mgr);
+        tx->handle_abort<size_t, size_t>(record_mgr);
+        EXPECT_FALSE(q.isLocked());
+        EXPECT_EQ(q.get_size(), 1);
+        EXPECT_EQ(q.dequeue(record_mgr), 1);
+        q.deinit_queue(record_mgr);
+    });
+    t.join();
+}
+
+TEST(QueueTransaction, conflictingDequeueAborts) {
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(2);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        Queue<size_t> q(tx, record_mgr);
+        q.enqueue(1, record_mgr);
+        tx->incrementAndGetVersion();
+        tx->TXbegin();
+        EXPECT_EQ(q.dequeue(record_mgr), 1);
+        std::thread other([&] {
+            RecordMgr<size_t, size_t> other_record_mgr(global_record_mgr, 1);
+            tx->TXbegin();
+            EXPECT_THROW(q.dequeue(other_record_mgr), TxAbortException);
+            tx->handle_abort<size_t, size_t>(other_record_mgr);
+        });
+        other.join();
+        tx->TXend<size_t, size_t>(record_mgr);
+        EXPECT_TRUE(q.isEmpty(record_mgr));
+        q.deinit_queue(record_mgr);
+    });
+    t.join();
+}
+
+TEST(QueueTransaction, singletonWriteAbortsEnqueueOnlyTransaction) {
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(2);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        Queue<size_t> q(tx, record_mgr);
+        tx->TXbegin();
+        q.enqueue(1, record_mgr);
+        std::thread([&] {
+            q.enqueue(2, record_mgr);
+        }).join();
+        EXPECT_THROW((tx->TXend<size_t, size_t>(record_mgr)), TxAbortException);
+        EXPECT_FALSE(q.isLocked());
+        EXPECT_EQ(q.get_size(), 1);
+        q.deinit_queue(record_mgr);
+    });
+    t.join();
+}
+
+TEST(QueueTransaction, queueAndListCommitTogether) {
+    std::thread t([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+        RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+        LinkedList<size_t, size_t> l(tx, record_mgr);
+        Queue<size_t> q(tx, record_mgr);
+        tx->TXbegin();
+        l.put(1, 10, record_mgr);
+        q.enqueue(10, record_mgr);
+        tx->TXend<size_t, size_t>(record_mgr);
+        EXPECT_EQ(l.get(1, record_mgr), 10);
+        EXPECT_EQ(q.dequeue(record_mgr), 10);
+        q.deinit_queue(record_mgr);
+    });
+    t.join();
+}
+
+TEST(QueueTransaction, concurrentTransfers) {
+    std::thread main_thread([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        const size_t n_threads = 4;
+        const size_t n_items = 1000;
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(n_threads + 1);
+        RecordMgr<size_t, size_t> main_record_mgr(global_record_mgr, n_threads);
+        Queue<size_t> from(tx, main_record_mgr);
+        Queue<size_t> to(tx, main_record_mgr);
+        for (size_t i = 0; i < n_items; i++) {
+            from.enqueue(i, main_record_mgr);
+        }
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < n_threads; t++) {
+            threads.emplace_back([&, t] {
+                RecordMgr<size_t, size_t> record_mgr(global_record_mgr, t);
+                while (true) {
+                    try {
+                        tx->TXbegin();
+                        if (from.isEmpty(record_mgr)) {
+                            tx->TXend<size_t, size_t>(record_mgr);
+                            return;
+                        }
+                        to.enqueue(from.dequeue(record_mgr), record_mgr);
+                        tx->TXend<size_t, size_t>(record_mgr);
+                    } catch (TxAbortException&) {
+                        tx->handle_abort<size_t, size_t>(record_mgr);
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        EXPECT_TRUE(from.isEmpty(main_record_mgr));
+        EXPECT_EQ(to.get_size(), n_items);
+        // a single thread moved a prefix of from at a time, so the order is kept
+        for (size_t i = 0; i < n_items; i++) {
+            EXPECT_EQ(to.dequeue(main_record_mgr), i);
+        }
+        from.deinit_queue(main_record_mgr);
+        to.deinit_queue(main_record_mgr);
+    });
+    main_thread.join();
+}
+
+// the setup and the checks in a fresh thread too, so the operations take the lock-free path
+TEST(QueueSingleton, concurrentProducersConsumers) {
+    std::thread main_thread([] {
+        std::shared_ptr<TX> tx = std::make_shared<TX>();
+        const size_t n_producers = 2;
+        const size_t n_consumers = 2;
+        const size_t n_items = 5000;
+        auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(n_producers + n_consumers + 1);
+        RecordMgr<size_t, size_t> main_record_mgr(global_record_mgr, n_producers + n_consumers);
+        Queue<size_t> q(tx, main_record_mgr);
+        std::atomic<size_t> consumed(0);
+        std::vector<std::vector<size_t>> seen(n_consumers);
+        std::vector<std::thread> threads;
+        for (size_t p = 0; p < n_producers; p++) {
+            threads.emplace_back([&, p] {
+                RecordMgr<size_t, size_t> record_mgr(global_record_mgr, p);
+                for (size_t i = 0; i < n_items; i++) {
+                    q.enqueue(p * n_items + i, record_mgr);
+                }
+            });
+        }
+        for (size_t c = 0; c < n_consumers; c++) {
+            threads.emplace_back([&, c] {
+                RecordMgr<size_t, size_t> record_mgr(global_record_mgr, n_producers + c);
+                while (consumed < n_producers * n_items) {
+                    try {
+                        seen[c].push_back(q.dequeue(record_mgr));
+                        consumed++;
+                    } catch (EmptyQueueException&) {
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        EXPECT_TRUE(q.isEmpty(main_record_mgr));
+        EXPECT_EQ(q.get_size(), 0);
+        // every value came out once, and in the order its producer put it in
+        std::vector<bool> found(n_producers * n_items, false);
+        for (auto& values : seen) {
+            std::vector<size_t> last(n_producers, 0);
+            std::vector<bool> any(n_producers, false);
+            for (auto v : values) {
+                EXPECT_FALSE(found[v]);
+                found[v] = true;
+                size_t p = v / n_items;
+                if (any[p]) {
+                    EXPECT_LT(last[p], v);
+                }
+                any[p] = true;
+                last[p] = v;
+            }
+        }
+        EXPECT_EQ(std::count(found.begin(), found.end(), true), n_producers * n_items);
+        q.deinit_queue(main_record_mgr);
+    });
+    main_thread.join();
+}
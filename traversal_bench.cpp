@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "datatypes/LinkedList.h"
+
+/**
+ * list traversal microbenchmark: walks a list of n_keys nodes (inserted in random order) and reports
+ * the time and the cache misses per traversal step, for comparing node layouts (see LNODE_COMPACT in LNode.h)
+ * and node handles (LNodeWrapper.h)
+ * usage: traversal_bench [n_keys] [n_rounds] [n_lookups]
+ */
+
+// a hardware counter of this thread (user space only), reads 0 if perf events aren't available
+class PerfCounter {
+public:
+    PerfCounter(uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~PerfCounter() {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    PerfCounter(const PerfCounter&) = delete;
+
+    bool available() const { return m_fd >= 0; }
+
+    void start() {
+        if (m_fd >= 0) {
+            ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    uint64_t stop() {
+        uint64_t count = 0;
+        if (m_fd >= 0) {
+            ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(m_fd, &count, sizeof(count)) != sizeof(count)) {
+                count = 0;
+            }
+        }
+        return count;
+    }
+
+private:
+    int m_fd;
+};
+
+struct Counters {
+    PerfCounter llc_misses{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES};
+    PerfCounter l1d_misses{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+
+    void start() {
+        l1d_misses.start();
+        llc_misses.start();
+    }
+
+    void stopAndPrint(const std::string& name, uint64_t steps, std::chrono::duration<double> time) {
+        uint64_t llc = llc_misses.stop();
+        uint64_t l1d = l1d_misses.stop();
+        std::cout << name << ": " << steps << " steps, " << time.count() * 1e9 / steps << " ns/step";
+        if (l1d_misses.available()) {
+            std::cout << ", L1D misses/step: " << static_cast<double>(l1d) / steps;
+        } else {
+            std::cout << ", L1D misses/step: n/a";
+        }
+        if (llc_misses.available()) {
+            std::cout << ", LLC misses/step: " << static_cast<double>(llc) / steps;
+        } else {
+            std::cout << ", LLC misses/step: n/a";
+        }
+        std::cout << std::endl;
+    }
+};
+
+int main(int argc, char *argv[]) {
+    using node_t = LNode<size_t, size_t>;
+    size_t n_keys = argc > 1 ? std::atoi(argv[1]) : 100000;
+    size_t n_rounds = argc > 2 ? std::atoi(argv[2]) : 20;
+    size_t n_lookups = argc > 3 ? std::atoi(argv[3]) : 20000;
+
+    std::cout << "layout: " << (node_t::COMPACT ? "compact" : "default")
+              << ", sizeof(LNode): " << sizeof(node_t)
+              << ", alignof(LNode): " << alignof(node_t)
+              << ", hot fields: " << node_t::HOT_SIZE << " bytes"
+              << ", value " << (node_t::INLINE_VAL ? "inline" : "on its own line") << std::endl;
+
+    auto global_record_mgr = RecordMgr<size_t, size_t>::make_record_mgr(1);
+    RecordMgr<size_t, size_t> record_mgr(global_record_mgr, 0);
+    std::shared_ptr<TX> tx = std::make_shared<TX>();
+    LinkedList<size_t, size_t> l(tx, record_mgr);
+
+    // random insertion order, so list order and allocation order differ
+    std::vector<size_t> keys(n_keys);
+    for (size_t i = 0; i < n_keys; i++) {
+        keys[i] = i + 1;
+    }
+    std::mt19937_64 rng(1);
+    std::shuffle(keys.begin(), keys.end(), rng);
+    const size_t keys_per_tx = 1000;
+    for (size_t i = 0; i < n_keys; i += keys_per_tx) {
+        tx->TXbegin();
+        for (size_t j = i; j < std::min(n_keys, i + keys_per_tx); j++) {
+            l.put(keys[j], keys[j], record_mgr);
+        }
+        tx->TXend<size_t, size_t>(record_mgr);
+    }
+
+    Counters counters;
+    if (!counters.l1d_misses.available() && !counters.llc_misses.available()) {
+        std::cout << "perf events are not available, only reporting time" << std::endl;
+    }
+
+    // the raw walk: version word, key and next of every node, like find_node does
+    uint64_t steps = 0;
+    size_t sum = 0;
+    counters.start();
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (size_t r = 0; r < n_rounds; r++) {
+        auto cur = l.head->m_next;
+        while (cur.is_not_null()) {
+            if (!cur->isLocked()) {
+                sum += cur->m_key;
+            }
+            cur = cur->m_next;
+            steps++;
+        }
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    counters.stopAndPrint("walk", steps, end_time - start_time);
+
+    // lookups that end in a value read, through the index (singletons)
+    std::uniform_int_distribution<size_t> key_dist(1, n_keys);
+    counters.start();
+    start_time = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < n_lookups; i++) {
+        auto val = l.get(key_dist(rng), record_mgr);
+        if (val) {
+            size_t v = val;
+            sum += v;
+        }
+    }
+    end_time = std::chrono::high_resolution_clock::now();
+    counters.stopAndPrint("lookup", n_lookups, end_time - start_time);
+
+    // the same lookups in transactions, which copy node handles into the read set on the way
+    counters.start();
+    start_time = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < n_lookups; i++) {
+        tx->TXbegin();
+        auto val = l.get(key_dist(rng), record_mgr);
+        tx->TXend<size_t, size_t>(record_mgr);
+        if (val) {
+            size_t v = val;
+            sum += v;
+        }
+    }
+    end_time = std::chrono::high_resolution_clock::now();
+    counters.stopAndPrint("tx lookup", n_lookups, end_time - start_time);
+
+    // and with the context of TXbegin, no thread local lookups and one guard per transaction
+    counters.start();
+    start_time = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < n_lookups; i++) {
+        auto& ctx = tx->TXbegin(record_mgr);
+        auto val = l.get(ctx, key_dist(rng));
+        tx->TXend();
+        if (val) {
+            size_t v = val;
+            sum += v;
+        }
+    }
+    end_time = std::chrono::high_resolution_clock::now();
+    counters.stopAndPrint("tx ctx lookup", n_lookups, end_time - start_time);
+
+    std::cout << "checksum: " << sum << std::endl;
+    l.deinit_list(record_mgr);
+    return 0;
+}